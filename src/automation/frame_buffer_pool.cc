@@ -0,0 +1,49 @@
+#include "frame_buffer_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace dfg {
+
+// Only the pool's own reference is left. New references are only taken under
+// the pool mutex, so a free buffer stays free until it is handed out.
+static bool is_free(const cv::Mat &buffer) {
+  return std::atomic_ref(buffer.u->refcount).load() == 1;
+}
+
+cv::Mat FrameBufferPool::acquire(cv::Size size, int type) {
+  std::lock_guard lock(mutex);
+  for (auto &buffer : buffers) {
+    if (buffer.size() == size && buffer.type() == type && is_free(buffer)) {
+      counters.reuses++;
+      return buffer;
+    }
+  }
+
+  cv::Mat buffer(size, type);
+  counters.allocations++;
+  counters.allocated_bytes += buffer.total() * buffer.elemSize();
+  if (buffers.size() < max_buffers) {
+    buffers.push_back(buffer);
+  } else if (auto free = std::ranges::find_if(buffers, is_free);
+             free != buffers.end()) {
+    // a free buffer of another shape makes room, e.g. an old ROI size
+    *free = buffer;
+  }
+  return buffer;
+}
+
+cv::Mat FrameBufferPool::copy(const cv::Mat &image) {
+  auto buffer = acquire(image.size(), image.type());
+  image.copyTo(buffer);
+  return buffer;
+}
+
+FrameBufferPool::Stats FrameBufferPool::stats() {
+  std::lock_guard lock(mutex);
+  auto stats = counters;
+  stats.buffers = buffers.size();
+  return stats;
+}
+
+} // namespace dfg
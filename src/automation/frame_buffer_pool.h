@@ -0,0 +1,43 @@
+#pragma once
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace dfg {
+
+// Recycles the large images every capture needs instead of allocating a new
+// one each time. A buffer handed out by acquire is a plain cv::Mat; it becomes
+// free again on its own once the last cv::Mat sharing it is gone.
+class FrameBufferPool {
+public:
+  explicit FrameBufferPool(size_t max_buffers = 32)
+      : max_buffers(max_buffers) {}
+
+  // An uninitialized size x type image, a recycled one if a free buffer of
+  // that shape exists.
+  cv::Mat acquire(cv::Size size, int type);
+  // A pooled, continuous copy of image.
+  cv::Mat copy(const cv::Mat &image);
+
+  struct Stats {
+    // buffers that had to be allocated, including ones the pool could not
+    // keep because every kept buffer was in use
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+    // acquires answered with a recycled buffer
+    size_t reuses = 0;
+    // buffers the pool currently keeps
+    size_t buffers = 0;
+  };
+  Stats stats();
+
+private:
+  std::mutex mutex;
+  size_t max_buffers;
+  std::vector<cv::Mat> buffers;
+  Stats counters;
+};
+
+} // namespace dfg
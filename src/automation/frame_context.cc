@@ -0,0 +1,139 @@
+#include "frame_context.h"
+#include "gray_conversion.h"
+
+#include <algorithm>
+
+namespace dfg {
+
+FrameContext::FrameContext(cv::Mat native_bgra, int64_t timestamp,
+                           float scale, FrameBufferPool *pool)
+    : views(std::make_shared<Views>()) {
+  if (!native_bgra.empty() && native_bgra.channels() != 4) {
+    cv::cvtColor(native_bgra, native_bgra, cv::COLOR_BGR2BGRA);
+  }
+  views->native = std::move(native_bgra);
+  views->timestamp = timestamp;
+  views->pool = pool;
+  views->scale = scale;
+  views->size = scale == 1
+                    ? views->native.size()
+                    : cv::Size(cvRound(views->native.cols * scale),
+                               cvRound(views->native.rows * scale));
+}
+
+static const cv::Mat no_view;
+
+const cv::Mat &FrameContext::native() const {
+  return views ? views->native : no_view;
+}
+
+void FrameContext::build_gray() const {
+  if (empty()) {
+    return;
+  }
+  if (views->size == views->native.size()) {
+    gray();
+  } else {
+    native_gray();
+  }
+}
+
+cv::Mat FrameContext::buffer(cv::Size size, int type) const {
+  return views->pool ? views->pool->acquire(size, type) : cv::Mat(size, type);
+}
+
+static GrayPlane plane(cv::Mat &mat) {
+  return GrayPlane{mat.data, mat.step, mat.cols, mat.rows};
+}
+
+const cv::Mat &FrameContext::native_gray() const {
+  if (empty()) {
+    return no_view;
+  }
+  if (views->size == views->native.size()) {
+    return gray();
+  }
+  std::call_once(views->native_gray_once, [this] {
+    auto &native = views->native;
+    views->native_gray = buffer(native.size(), CV_8UC1);
+    bgra_to_gray(native.data, native.step, native.cols, native.rows,
+                 plane(views->native_gray));
+  });
+  return views->native_gray;
+}
+
+const cv::Mat &FrameContext::bgra() const {
+  if (empty()) {
+    return no_view;
+  }
+  if (views->size == views->native.size()) {
+    return views->native;
+  }
+  std::call_once(views->bgra_once, [this] {
+    views->bgra = buffer(views->size, CV_8UC4);
+    cv::resize(views->native, views->bgra, views->size, 0, 0,
+               cv::INTER_LINEAR);
+  });
+  return views->bgra;
+}
+
+const cv::Mat &FrameContext::gray() const {
+  if (empty()) {
+    return no_view;
+  }
+  std::call_once(views->gray_once, [this] {
+    auto &native = views->native;
+    views->gray = buffer(views->size, CV_8UC1);
+    bgra_to_gray(native.data, native.step, native.cols, native.rows,
+                 plane(views->gray));
+  });
+  return views->gray;
+}
+
+cv::Rect FrameContext::to_native(cv::Rect rect) const {
+  auto scale = this->scale();
+  if (scale == 1) {
+    return rect;
+  }
+  auto native = cv::Rect(
+      cv::Point(cvFloor(rect.x / scale), cvFloor(rect.y / scale)),
+      cv::Point(cvCeil(rect.br().x / scale), cvCeil(rect.br().y / scale)));
+  // rounding must not push a rect inside the frame over its native edge
+  if ((rect & cv::Rect({}, size())) == rect) {
+    native &= cv::Rect({}, views->native.size());
+  }
+  return native;
+}
+
+cv::Point FrameContext::to_native(cv::Point point) const {
+  auto scale = this->scale();
+  if (scale == 1) {
+    return point;
+  }
+  return cv::Point(
+      std::min(cvFloor((point.x + 0.5f) / scale), views->native.cols - 1),
+      std::min(cvFloor((point.y + 0.5f) / scale), views->native.rows - 1));
+}
+
+cv::Mat FrameContext::resampled(const cv::Mat &native, cv::Rect rect) const {
+  auto out = buffer(rect.size(), native.type());
+  cv::resize(native(to_native(rect)), out, rect.size(), 0, 0,
+             cv::INTER_LINEAR);
+  return out;
+}
+
+cv::Mat FrameContext::gray(cv::Rect rect) const {
+  if (empty() || views->size == views->native.size()) {
+    return gray()(rect);
+  }
+  return resampled(native_gray(), rect);
+}
+
+cv::Mat FrameContext::bgra(cv::Rect rect) const {
+  if (empty() || views->size == views->native.size()) {
+    return bgra()(rect);
+  }
+  return resampled(views->native, rect);
+}
+
+} // namespace dfg
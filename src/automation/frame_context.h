@@ -0,0 +1,78 @@
+#pragma once
+#include "opencv2/opencv.hpp"
+
+#include "frame_buffer_pool.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace dfg {
+
+// A captured frame plus every view derived from it. Views are computed on
+// first request and kept, so consumers sharing a frame never redo a
+// conversion. Safe to use from several threads; copies share the views.
+// Only views something in the tree reads are offered: there is no integral,
+// Lab, tile hash or pyramid view, a consumer that needs one adds it here.
+//
+// The frame is kept at its native size. With a scale other than 1 every view
+// but native() and native_gray() is at the scaled (develop) size; the color
+// frame is only resized if bgra() is asked for, gray comes from one fused
+// convert and resample pass over the native pixels. Template matching works on
+// native_gray(), and crops taken with gray(rect) and bgra(rect) resample only
+// the rect, so the scan never needs the whole frame resampled.
+class FrameContext {
+public:
+  FrameContext() = default;
+  // timestamp is the capture's SystemRelativeTime, see InputEpoch. With a
+  // pool, the derived views are built in recycled buffers; the pool has to
+  // outlive the frame.
+  explicit FrameContext(cv::Mat native_bgra, int64_t timestamp = 0,
+                        float scale = 1, FrameBufferPool *pool = nullptr);
+
+  // A default constructed frame is empty, its views are empty Mats.
+  bool empty() const { return !views || views->native.empty(); }
+  int64_t timestamp() const { return views ? views->timestamp : 0; }
+  int cols() const { return size().width; }
+  int rows() const { return size().height; }
+  cv::Size size() const { return views ? views->size : cv::Size(); }
+  // From the native size to the scaled size, see WindowGeometry::scale.
+  float scale() const { return views ? views->scale : 1; }
+
+  // The frame as captured, BGRA, at the native size.
+  const cv::Mat &native() const;
+  // gray at the native size, the same Mat as gray() when scale is 1.
+  const cv::Mat &native_gray() const;
+  // The frame in BGRA at the scaled size.
+  const cv::Mat &bgra() const;
+  const cv::Mat &gray() const;
+  // The part of gray() or bgra() under rect, in scaled coordinates, resampled
+  // from the native pixels under it. With scale 1 it is a plain crop.
+  cv::Mat gray(cv::Rect rect) const;
+  cv::Mat bgra(cv::Rect rect) const;
+  // Computes the gray view matching needs now, e.g. on the capturing thread:
+  // gray, or native_gray with a scale.
+  void build_gray() const;
+
+  // Maps scaled coordinates onto the native frame. A rect is widened to whole
+  // native pixels, a point lands on the native pixel under its center.
+  cv::Rect to_native(cv::Rect rect) const;
+  cv::Point to_native(cv::Point point) const;
+
+private:
+  cv::Mat buffer(cv::Size size, int type) const;
+  cv::Mat resampled(const cv::Mat &native, cv::Rect rect) const;
+
+  struct Views {
+    cv::Mat native;
+    cv::Size size;
+    float scale = 1;
+    int64_t timestamp = 0;
+    FrameBufferPool *pool = nullptr;
+    std::once_flag bgra_once, native_gray_once, gray_once;
+    cv::Mat bgra, native_gray, gray;
+  };
+  std::shared_ptr<Views> views;
+};
+
+} // namespace dfg
@@ -0,0 +1,85 @@
+#include "gray_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace dfg {
+
+// 0.114, 0.587, 0.299 in 14-bit fixed point, as cv::cvtColor uses them
+static constexpr int gray_b = 1868, gray_g = 9617, gray_r = 4899;
+static constexpr int gray_shift = 14;
+
+static void gray_row(const uint8_t *src, uint8_t *dst, int width) {
+  for (int x = 0; x < width; ++x) {
+    const uint8_t *p = src + x * 4;
+    dst[x] = static_cast<uint8_t>(
+        (p[0] * gray_b + p[1] * gray_g + p[2] * gray_r +
+         (1 << (gray_shift - 1))) >>
+        gray_shift);
+  }
+}
+
+// source coordinate and 8-bit weight of the next sample for each output
+// coordinate, pixel centers aligned like cv::INTER_LINEAR
+static void bilinear_taps(int src_size, int dst_size, std::vector<int> &index,
+                          std::vector<int> &weight) {
+  index.resize(dst_size);
+  weight.resize(dst_size);
+  float ratio = static_cast<float>(src_size) / dst_size;
+  for (int i = 0; i < dst_size; ++i) {
+    float f = (i + 0.5f) * ratio - 0.5f;
+    int i0 = std::clamp(static_cast<int>(std::floor(f)), 0, src_size - 1);
+    index[i] = i0;
+    weight[i] = std::clamp(static_cast<int>((f - i0) * 256 + 0.5f), 0, 256);
+  }
+}
+
+void bgra_to_gray(const uint8_t *bgra, size_t bgra_step, int width, int height,
+                  GrayPlane gray) {
+  bool resample = gray.width != width || gray.height != height;
+
+  std::vector<int> x_index, x_weight, y_index, y_weight;
+  // gray versions of the two source rows the current output row reads
+  std::vector<uint8_t> lines;
+  int line_rows[2] = {-1, -1};
+  if (resample) {
+    bilinear_taps(width, gray.width, x_index, x_weight);
+    bilinear_taps(height, gray.height, y_index, y_weight);
+    lines.resize(2 * static_cast<size_t>(width));
+  }
+  auto source_line = [&](int row) {
+    int slot = row & 1;
+    uint8_t *line = lines.data() + slot * static_cast<size_t>(width);
+    if (line_rows[slot] != row) {
+      gray_row(bgra + row * bgra_step, line, width);
+      line_rows[slot] = row;
+    }
+    return line;
+  };
+
+  for (int y = 0; y < gray.height; ++y) {
+    uint8_t *out = gray.data + y * gray.step;
+    if (!resample) {
+      gray_row(bgra + y * bgra_step, out, width);
+    } else {
+      int y0 = y_index[y];
+      int y1 = std::min(y0 + 1, height - 1);
+      int wy = y_weight[y];
+      // consecutive rows land in different slots
+      const uint8_t *top = source_line(y0);
+      const uint8_t *bottom = source_line(y1);
+      for (int x = 0; x < gray.width; ++x) {
+        int x0 = x_index[x];
+        int x1 = std::min(x0 + 1, width - 1);
+        int wx = x_weight[x];
+        int t = top[x0] * (256 - wx) + top[x1] * wx;
+        int b = bottom[x0] * (256 - wx) + bottom[x1] * wx;
+        out[x] = static_cast<uint8_t>((t * (256 - wy) + b * wy + (1 << 15)) >>
+                                      16);
+      }
+    }
+  }
+}
+
+} // namespace dfg
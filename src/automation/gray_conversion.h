@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace dfg {
+
+// A writable 8-bit single channel image.
+struct GrayPlane {
+  uint8_t *data = nullptr;
+  size_t step = 0;
+  int width = 0, height = 0;
+};
+
+// Converts a BGRA image to gray in one pass over the source. If gray differs
+// in size from the source, the source is resampled bilinearly on the way, so
+// a scaled frame never needs a color resize: every source row is converted
+// once and interpolated while still in cache. All arithmetic is fixed point
+// (the gray weights of cv::COLOR_BGR2GRAY, 8-bit bilinear weights).
+void bgra_to_gray(const uint8_t *bgra, size_t bgra_step, int width, int height,
+                  GrayPlane gray);
+
+} // namespace dfg
@@ -1,68 +1,125 @@
 #include "input_simulator.h"
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
 namespace dfg {
 
-void InputSimulator::move_to(int x, int y, int duration_ms,
-                             std::function<float(float)> interp) {
-  POINT current_pos = get_mouse_position();
-  int start_x = current_pos.x;
-  int start_y = current_pos.y;
+int64_t system_relative_time() {
+  static const int64_t frequency = [] {
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    return f.QuadPart;
+  }();
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  // split to avoid overflowing counter * 10^7
+  return counter.QuadPart / frequency * 10'000'000 +
+         counter.QuadPart % frequency * 10'000'000 / frequency;
+}
 
-  if (duration_ms <= 0) {
+InputEpoch InputSimulator::send(INPUT &input) {
+  SendInput(1, &input, sizeof(INPUT));
+  InputEpoch epoch{epoch_counter.fetch_add(1) + 1, system_relative_time()};
+  last_epoch_time.store(epoch.time);
+  return epoch;
+}
+
+InputEpoch InputSimulator::last_epoch() {
+  return {epoch_counter.load(), last_epoch_time.load()};
+}
+
+InputSimulator::InputSimulator() {
+  refresh_metrics();
+  // enough for a 1s move, so regular moves never reallocate
+  path.reserve(1000 / step_ms + 2);
+  step_timer = CreateWaitableTimerExW(nullptr, nullptr,
+                                      CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                      TIMER_ALL_ACCESS);
+}
 
-    INPUT input = {0};
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
-    input.mi.dx = (x * 65535) / GetSystemMetrics(SM_CXSCREEN);
-    input.mi.dy = (y * 65535) / GetSystemMetrics(SM_CYSCREEN);
-    SendInput(1, &input, sizeof(INPUT));
-    return;
+InputSimulator::~InputSimulator() {
+  if (step_timer) {
+    CloseHandle(step_timer);
   }
+}
 
-  auto start_time = std::chrono::high_resolution_clock::now();
-  auto end_time = start_time + std::chrono::milliseconds(duration_ms);
+void InputSimulator::refresh_metrics() {
+  screen_width = GetSystemMetrics(SM_CXSCREEN);
+  screen_height = GetSystemMetrics(SM_CYSCREEN);
+}
 
-  while (std::chrono::high_resolution_clock::now() < end_time) {
-    auto now = std::chrono::high_resolution_clock::now();
-    float t = static_cast<float>(
-                  std::chrono::duration_cast<std::chrono::milliseconds>(
-                      now - start_time)
-                      .count()) /
-              duration_ms;
-    t = std::min(1.0f, std::max(0.0f, t));
+INPUT InputSimulator::absolute_move(int x, int y) const {
+  INPUT input = {0};
+  input.type = INPUT_MOUSE;
+  input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
+  input.mi.dx = (x * 65535) / screen_width;
+  input.mi.dy = (y * 65535) / screen_height;
+  return input;
+}
 
-    float interpolated_t = interp(t);
+InputEpoch InputSimulator::move_along(int x, int y, int duration_ms,
+                                      std::span<const float> curve) {
+  if (duration_ms <= 0) {
+    INPUT input = absolute_move(x, y);
+    return send(input);
+  }
 
-    int current_x = static_cast<int>(start_x + (x - start_x) * interpolated_t);
-    int current_y = static_cast<int>(start_y + (y - start_y) * interpolated_t);
+  POINT current_pos = get_mouse_position();
+  int start_x = current_pos.x;
+  int start_y = current_pos.y;
 
-    INPUT input = {0};
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
-    input.mi.dx = (current_x * 65535) / GetSystemMetrics(SM_CXSCREEN);
-    input.mi.dy = (current_y * 65535) / GetSystemMetrics(SM_CYSCREEN);
-    SendInput(1, &input, sizeof(INPUT));
+  // the last step always lands exactly on the target
+  int steps = std::max(1, duration_ms / step_ms);
+  path.resize(steps);
+  size_t segments = curve.size() - 1;
+  for (int i = 0; i < steps; ++i) {
+    float t = static_cast<float>(i + 1) / steps;
+    float pos = t * segments;
+    size_t index = std::min(static_cast<size_t>(pos), segments - 1);
+    float frac = pos - index;
+    float interpolated_t =
+        curve[index] + (curve[index + 1] - curve[index]) * frac;
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    int current_x = static_cast<int>(start_x + (x - start_x) * interpolated_t);
+    int current_y = static_cast<int>(start_y + (y - start_y) * interpolated_t);
+    path[i] = absolute_move(current_x, current_y);
   }
 
-  INPUT input = {0};
-  input.type = INPUT_MOUSE;
-  input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
-  input.mi.dx = (x * 65535) / GetSystemMetrics(SM_CXSCREEN);
-  input.mi.dy = (y * 65535) / GetSystemMetrics(SM_CYSCREEN);
-  SendInput(1, &input, sizeof(INPUT));
+  // deadlines are absolute, so a late wakeup does not delay later steps
+  auto start_time = std::chrono::steady_clock::now();
+  InputEpoch epoch;
+  for (int i = 0; i < steps; ++i) {
+    if (i > 0) {
+      auto deadline = start_time + std::chrono::milliseconds(step_ms * i);
+      auto remaining = deadline - std::chrono::steady_clock::now();
+      if (remaining > std::chrono::steady_clock::duration::zero()) {
+        if (step_timer) {
+          // negative due time is relative, in 100ns units
+          using hundred_ns =
+              std::chrono::duration<LONGLONG, std::ratio<1, 10000000>>;
+          LARGE_INTEGER due;
+          due.QuadPart =
+              -std::chrono::duration_cast<hundred_ns>(remaining).count();
+          SetWaitableTimer(step_timer, &due, 0, nullptr, nullptr, FALSE);
+          WaitForSingleObject(step_timer, INFINITE);
+        } else {
+          std::this_thread::sleep_until(deadline);
+        }
+      }
+    }
+    epoch = send(path[i]);
+  }
+  return epoch;
 }
 
-void InputSimulator::move_relative(int dx, int dy) {
+InputEpoch InputSimulator::move_relative(int dx, int dy) {
   INPUT input = {0};
   input.type = INPUT_MOUSE;
   input.mi.dwFlags = MOUSEEVENTF_MOVE;
   input.mi.dx = dx;
   input.mi.dy = dy;
-  SendInput(1, &input, sizeof(INPUT));
+  return send(input);
 }
 
 POINT InputSimulator::get_mouse_position() {
@@ -71,49 +128,49 @@ POINT InputSimulator::get_mouse_position() {
   return p;
 }
 
-void InputSimulator::mouse_event(DWORD event_flags, DWORD data) {
+InputEpoch InputSimulator::mouse_event(DWORD event_flags, DWORD data) {
   INPUT input = {0};
   input.type = INPUT_MOUSE;
   input.mi.dwFlags = event_flags;
   input.mi.mouseData = data;
-  SendInput(1, &input, sizeof(INPUT));
+  return send(input);
 }
 
-void InputSimulator::left_click() {
+InputEpoch InputSimulator::left_click() {
   mouse_event(MOUSEEVENTF_LEFTDOWN);
-  mouse_event(MOUSEEVENTF_LEFTUP);
+  return mouse_event(MOUSEEVENTF_LEFTUP);
 }
 
-void InputSimulator::right_click() {
+InputEpoch InputSimulator::right_click() {
   mouse_event(MOUSEEVENTF_RIGHTDOWN);
-  mouse_event(MOUSEEVENTF_RIGHTUP);
+  return mouse_event(MOUSEEVENTF_RIGHTUP);
 }
 
-void InputSimulator::key_press(WORD vk_code) {
+InputEpoch InputSimulator::key_press(WORD vk_code) {
   INPUT input = {0};
   input.type = INPUT_KEYBOARD;
   input.ki.wVk = 0;
   input.ki.wScan = MapVirtualKeyA(vk_code, 0);
   input.ki.dwFlags = KEYEVENTF_SCANCODE;
-  SendInput(1, &input, sizeof(INPUT));
+  return send(input);
 }
 
-void InputSimulator::key_release(WORD vk_code) {
+InputEpoch InputSimulator::key_release(WORD vk_code) {
   INPUT input = {0};
   input.type = INPUT_KEYBOARD;
   input.ki.wVk = 0;
   input.ki.wScan = MapVirtualKeyA(vk_code, 0);
   input.ki.dwFlags = KEYEVENTF_KEYUP | KEYEVENTF_SCANCODE;
-  SendInput(1, &input, sizeof(INPUT));
+  return send(input);
 }
 
-void InputSimulator::key_tap(WORD vk_code) {
+InputEpoch InputSimulator::key_tap(WORD vk_code) {
   key_press(vk_code);
   std::this_thread::sleep_for(std::chrono::milliseconds(50));
-  key_release(vk_code);
+  return key_release(vk_code);
 }
 
-void InputSimulator::type_text(const std::string &text) {
+InputEpoch InputSimulator::type_text(const std::string &text) {
   for (char c : text) {
     if (c >= 32 && c <= 126) {
       SHORT vk = VkKeyScanA(c);
@@ -133,13 +190,14 @@ void InputSimulator::type_text(const std::string &text) {
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(50));
   }
+  return last_epoch();
 }
 
-void InputSimulator::wheel_scroll(int delta) {
+InputEpoch InputSimulator::wheel_scroll(int delta) {
   INPUT input = {0};
   input.type = INPUT_MOUSE;
   input.mi.dwFlags = MOUSEEVENTF_WHEEL;
   input.mi.mouseData = delta;
-  SendInput(1, &input, sizeof(INPUT));
+  return send(input);
 }
 } // namespace dfg
\ No newline at end of file
@@ -1,34 +1,97 @@
 #pragma once
 
-#include <functional>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <vector>
 #include <windows.h>
 
 namespace dfg {
 
+// Easing curves for mouse moves. Each is sampled into a constexpr table at
+// compile time, so a move never calls the curve itself.
+namespace easing {
+struct Linear {
+  static constexpr float at(float t) { return t; }
+};
+struct EaseInOutQuad {
+  static constexpr float at(float t) {
+    return t < 0.5f ? 2 * t * t : 1 - (-2 * t + 2) * (-2 * t + 2) / 2;
+  }
+};
+struct EaseOutCubic {
+  static constexpr float at(float t) {
+    return 1 - (1 - t) * (1 - t) * (1 - t);
+  }
+};
+
+inline constexpr size_t table_size = 64;
+template <typename Easing>
+inline constexpr std::array<float, table_size + 1> table = [] {
+  std::array<float, table_size + 1> samples{};
+  for (size_t i = 0; i <= table_size; ++i) {
+    samples[i] = Easing::at(static_cast<float>(i) / table_size);
+  }
+  return samples;
+}();
+} // namespace easing
+
+// 100ns ticks on the QPC clock, the same time base as
+// Direct3D11CaptureFrame::SystemRelativeTime.
+int64_t system_relative_time();
+
+// Identifies one injected input: a monotonically increasing id and the time
+// SendInput returned. A frame stamped later than `time` can show its effect.
+struct InputEpoch {
+  uint64_t id = 0;
+  int64_t time = 0;
+};
+
 class InputSimulator {
 public:
-  InputSimulator() = default;
-  ~InputSimulator() = default;
+  InputSimulator();
+  ~InputSimulator();
 
-  void move_to(
-      int x, int y, int duration_ms = 200,
-      std::function<float(float)> interp = [](float t) {
-        return t < 0.5 ? 2 * t * t : 1 - pow(-2 * t + 2, 2) / 2;
-      });
+  // The whole path is generated into a reused buffer up front, then replayed
+  // one event per step on absolute deadlines of a high resolution timer.
+  template <typename Easing = easing::EaseInOutQuad>
+  InputEpoch move_to(int x, int y, int duration_ms = 200) {
+    return move_along(x, y, duration_ms, easing::table<Easing>);
+  }
+  // Re-read the screen size, e.g. after a display change or once the process
+  // became DPI aware.
+  void refresh_metrics();
 
-  void move_relative(int dx, int dy);
+  InputEpoch move_relative(int dx, int dy);
   POINT get_mouse_position();
-  void mouse_event(DWORD event_flags, DWORD data = 0);
-  void left_click();
-  void right_click();
-  void key_press(WORD vk_code);
-  void key_release(WORD vk_code);
-  void key_tap(WORD vk_code);
-  void type_text(const std::string &text);
-  void wheel_scroll(int delta);
+  InputEpoch mouse_event(DWORD event_flags, DWORD data = 0);
+  InputEpoch left_click();
+  InputEpoch right_click();
+  InputEpoch key_press(WORD vk_code);
+  InputEpoch key_release(WORD vk_code);
+  InputEpoch key_tap(WORD vk_code);
+  InputEpoch type_text(const std::string &text);
+  InputEpoch wheel_scroll(int delta);
+
+  // The epoch of the most recent input sent by any simulator.
+  static InputEpoch last_epoch();
 
 private:
+  InputEpoch move_along(int x, int y, int duration_ms,
+                        std::span<const float> curve);
+  INPUT absolute_move(int x, int y) const;
+  // SendInput plus a new epoch stamped after the call returned.
+  static InputEpoch send(INPUT &input);
+
+  static inline std::atomic<uint64_t> epoch_counter{0};
+  static inline std::atomic<int64_t> last_epoch_time{0};
+
+  static constexpr int step_ms = 4;
+  int screen_width = 0, screen_height = 0;
+  std::vector<INPUT> path;
+  HANDLE step_timer = nullptr;
 };
 
 } // namespace dfg
\ No newline at end of file
@@ -6,6 +6,12 @@
 #include <leptonica/pix.h>
 #include <tesseract/baseapi.h>
 #include <tesseract/ocrclass.h>
+#include <tesseract/resultiterator.h>
+
+#include "../utils/mapped_file.hpp"
+
+#include <filesystem>
+#include <print>
 
 struct Pix_Box {
   l_int32 x;
@@ -16,10 +22,50 @@ struct Pix_Box {
 };
 
 namespace dfg {
-OCR::OCR() { api = std::make_unique<tesseract::TessBaseAPI>(); }
-OCR::~OCR() { api->End(); }
-void OCR::initialize() {
-  api->Init("./models/", "eng", tesseract::OEM_LSTM_ONLY);
+OCR::OCR() = default;
+OCR::~OCR() {
+  for (auto engine : {&digits_engine, &text_engine}) {
+    if (engine->api) {
+      engine->api->End();
+    }
+  }
+}
+std::string OCR::default_language() {
+  return std::filesystem::exists("./models/digits.traineddata") ? "digits"
+                                                                 : "eng";
+}
+void OCR::initialize(const std::string &language) {
+  std::lock_guard lock(api_mutex);
+  load(digits_engine, language, false);
+}
+void OCR::load(Engine &engine, const std::string &language,
+               bool dictionaries) {
+  // Tesseract copies the buffer it is given, so the mapping does not lower
+  // the resident size once loaded. It only spares the private read buffer we
+  // would otherwise fill first, and the mapped pages go away with this scope.
+  MappedFile model("./models/" + language + ".traineddata");
+
+  // Digits are never looked up in the dictionaries. Skipping them saves most
+  // of the parse time and memory of the full English model.
+  static const std::vector<std::string> vars = {
+      "load_system_dawg", "load_freq_dawg",      "load_punc_dawg",
+      "load_number_dawg", "load_unambig_dawg",   "load_bigram_dawg"};
+  static const std::vector<std::string> values(vars.size(), "0");
+
+  auto api = std::make_unique<tesseract::TessBaseAPI>();
+  if (api->Init(model.data(), static_cast<int>(model.size()),
+                language.c_str(), tesseract::OEM_LSTM_ONLY, nullptr, 0,
+                dictionaries ? nullptr : &vars,
+                dictionaries ? nullptr : &values, false, nullptr) != 0) {
+    throw std::runtime_error("Failed to initialize OCR model: " + language);
+  }
+  if (engine.api) {
+    engine.api->End();
+  }
+  engine.api = std::move(api);
+  engine.applied_whitelist.clear();
+  std::println("[ocr] loaded model {} ({} KiB{})", language,
+               model.size() / 1024, dictionaries ? "" : ", no dictionaries");
 }
 static std::string charPtrToString(const char *ptr) {
   if (!ptr) {
@@ -30,7 +76,9 @@ static std::string charPtrToString(const char *ptr) {
   return str;
 }
 
-std::optional<std::string> OCR::recognize_text_eng(const cv::Mat &image) {
+// Tesseract expects dark text on a light background, while the game renders
+// light text on dark panels.
+static cv::Mat preprocess(const cv::Mat &image) {
   auto image_p = image.clone();
 
   if (cv::mean(image_p)[0] < 128) {
@@ -40,9 +88,265 @@ std::optional<std::string> OCR::recognize_text_eng(const cv::Mat &image) {
   if (image_p.channels() > 1) {
     cv::cvtColor(image_p, image_p, cv::COLOR_BGR2GRAY);
   }
+  return image_p;
+}
+
+// The slower alternative for crops the first pass was unsure about: small
+// glyphs are upscaled, binarized and given a white border.
+static cv::Mat preprocess_retry(const cv::Mat &prepared) {
+  cv::Mat image_p;
+  cv::resize(prepared, image_p, cv::Size(), 2, 2, cv::INTER_CUBIC);
+  cv::threshold(image_p, image_p, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+  cv::copyMakeBorder(image_p, image_p, 10, 10, 10, 10, cv::BORDER_CONSTANT,
+                     cv::Scalar(255));
+  return image_p;
+}
+
+size_t OCR::CropSignatureHash::operator()(const CropSignature &sig) const {
+  // FNV-1a over the signature words
+  uint64_t hash = 14695981039346656037ull;
+  for (auto word : sig) {
+    hash ^= word;
+    hash *= 1099511628211ull;
+  }
+  return static_cast<size_t>(hash);
+}
+
+std::optional<OCR::CropSignature>
+OCR::signature(const cv::Mat &prepared, const OCRProfile &profile) {
+  cv::Mat binary;
+  cv::threshold(prepared, binary, 0, 255,
+                cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+
+  // crop to the ink, so the same text at a slightly different offset still
+  // produces the same signature
+  std::vector<cv::Point> ink;
+  cv::findNonZero(binary, ink);
+  if (ink.empty()) {
+    return {};
+  }
+  auto ink_box = cv::boundingRect(ink);
+
+  cv::Mat small;
+  cv::resize(binary(ink_box), small, cv::Size(128, 16), 0, 0, cv::INTER_AREA);
+
+  CropSignature sig{};
+  for (int y = 0; y < small.rows; ++y) {
+    auto row = small.ptr<uint8_t>(y);
+    for (int x = 0; x < small.cols; ++x) {
+      if (row[x] >= 128) {
+        int bit = y * small.cols + x;
+        sig[bit / 64] |= 1ull << (bit % 64);
+      }
+    }
+  }
+  sig[32] = (uint64_t(ink_box.width) << 32) | uint64_t(ink_box.height);
+  sig[33] = std::hash<std::string>{}(profile.name);
+  return sig;
+}
+
+std::optional<OCRResult> OCR::cache_lookup(const CropSignature &sig) {
+  auto it = cache_index.find(sig);
+  if (it == cache_index.end()) {
+    stats.misses++;
+    return {};
+  }
+  stats.hits++;
+  cache_lru.splice(cache_lru.begin(), cache_lru, it->second);
+  return it->second->second;
+}
 
-  api->SetImage(image_p.data, image_p.cols, image_p.rows, image_p.channels(),
-                image_p.step[0]);
-  return charPtrToString(api->GetUTF8Text());
+void OCR::cache_store(const CropSignature &sig, const OCRResult &result) {
+  if (cache_capacity == 0) {
+    return;
+  }
+  if (auto it = cache_index.find(sig); it != cache_index.end()) {
+    it->second->second = result;
+    cache_lru.splice(cache_lru.begin(), cache_lru, it->second);
+    return;
+  }
+  while (cache_lru.size() >= cache_capacity) {
+    cache_index.erase(cache_lru.back().first);
+    cache_lru.pop_back();
+  }
+  cache_lru.emplace_front(sig, result);
+  cache_index[sig] = cache_lru.begin();
+}
+
+std::optional<int> OCR::parse_int(const std::string &text) {
+  std::string num_str;
+  for (char c : text) {
+    if (isdigit(static_cast<unsigned char>(c))) {
+      num_str += c;
+    }
+  }
+  if (num_str.empty() || num_str.size() > 9) {
+    return {};
+  }
+  return std::stoi(num_str);
+}
+
+tesseract::TessBaseAPI &OCR::apply_profile(const OCRProfile &profile,
+                                           tesseract::PageSegMode psm) {
+  auto &engine = profile.digits ? digits_engine : text_engine;
+  if (!engine.api) {
+    load(engine, profile.digits ? default_language() : "eng",
+         !profile.digits);
+  }
+
+  auto &api = *engine.api;
+  api.SetPageSegMode(psm);
+  if (engine.applied_whitelist != profile.whitelist) {
+    api.SetVariable("tessedit_char_whitelist", profile.whitelist.c_str());
+    engine.applied_whitelist = profile.whitelist;
+  }
+  return api;
+}
+
+OCRResult OCR::recognize_prepared(const cv::Mat &prepared,
+                                  const OCRProfile &profile) {
+  auto &api = apply_profile(profile, profile.psm);
+  auto recognize = [&](const cv::Mat &image_p) {
+    api.SetImage(image_p.data, image_p.cols, image_p.rows, image_p.channels(),
+                 image_p.step[0]);
+    OCRResult result;
+    result.text = charPtrToString(api.GetUTF8Text());
+    result.confidence = static_cast<float>(api.MeanTextConf());
+    return result;
+  };
+
+  auto result = recognize(prepared);
+  if (result.confidence < profile.retry_below_confidence) {
+    stats.retries++;
+    auto retried = recognize(preprocess_retry(prepared));
+    if (retried.confidence > result.confidence) {
+      result = std::move(retried);
+    }
+  }
+  return result;
+}
+
+std::optional<OCRResult> OCR::recognize_text_eng(const cv::Mat &image,
+                                                 const OCRProfile &profile) {
+  std::lock_guard lock(api_mutex);
+  auto image_p = preprocess(image);
+
+  auto sig = signature(image_p, profile);
+  if (sig) {
+    if (auto cached = cache_lookup(*sig)) {
+      return cached;
+    }
+  }
+
+  auto result = recognize_prepared(image_p, profile);
+  if (sig) {
+    cache_store(*sig, result);
+  }
+  return result;
+}
+
+std::optional<int> OCR::recognize_int_eng(const cv::Mat &image,
+                                          const OCRProfile &profile) {
+  auto result = recognize_text_eng(image, profile);
+  if (!result) {
+    return {};
+  }
+  return parse_int(result->text);
+}
+
+std::vector<std::optional<OCRResult>>
+OCR::recognize_batch_eng(const std::vector<cv::Mat> &images,
+                         const OCRProfile &profile) {
+  std::lock_guard lock(api_mutex);
+  std::vector<std::optional<OCRResult>> results(images.size());
+
+  // blank margin around and between crops, so lines never touch each other
+  constexpr int gap = 16;
+
+  // only the crops that missed the cache go to Tesseract
+  std::vector<size_t> pending;
+  std::vector<cv::Mat> prepared;
+  std::vector<std::optional<CropSignature>> signatures;
+  int width = 0, height = gap;
+  for (size_t i = 0; i < images.size(); ++i) {
+    auto image_p = preprocess(images[i]);
+    auto sig = signature(image_p, profile);
+    if (sig) {
+      if (auto cached = cache_lookup(*sig)) {
+        results[i] = std::move(cached);
+        continue;
+      }
+    }
+
+    width = std::max(width, image_p.cols);
+    height += image_p.rows + gap;
+    pending.push_back(i);
+    prepared.push_back(std::move(image_p));
+    signatures.push_back(sig);
+  }
+
+  if (pending.empty()) {
+    return results;
+  }
+
+  cv::Mat stacked(height, width + 2 * gap, CV_8UC1, cv::Scalar(255));
+  // [begin, end) row span of every pending crop inside the stacked image
+  std::vector<std::pair<int, int>> spans;
+  spans.reserve(prepared.size());
+  int y = gap;
+  for (const auto &image_p : prepared) {
+    image_p.copyTo(stacked(cv::Rect(gap, y, image_p.cols, image_p.rows)));
+    spans.emplace_back(y, y + image_p.rows);
+    y += image_p.rows + gap;
+  }
+
+  auto &api = apply_profile(profile, tesseract::PSM_SINGLE_COLUMN);
+  api.SetImage(stacked.data, stacked.cols, stacked.rows, 1, stacked.step[0]);
+
+  if (api.Recognize(nullptr) == 0) {
+    std::unique_ptr<tesseract::ResultIterator> it(api.GetIterator());
+    if (it) {
+      do {
+        int left, top, right, bottom;
+        if (!it->BoundingBox(tesseract::RIL_TEXTLINE, &left, &top, &right,
+                             &bottom)) {
+          continue;
+        }
+
+        auto line = charPtrToString(it->GetUTF8Text(tesseract::RIL_TEXTLINE));
+        auto confidence = it->Confidence(tesseract::RIL_TEXTLINE);
+        int center_y = (top + bottom) / 2;
+        for (size_t i = 0; i < spans.size(); ++i) {
+          if (center_y >= spans[i].first - gap / 2 &&
+              center_y < spans[i].second + gap / 2) {
+            auto &result = results[pending[i]];
+            if (!result) {
+              result = OCRResult{line, confidence};
+            } else {
+              // several lines in one crop, keep the weakest confidence
+              result->text += line;
+              result->confidence = std::min(result->confidence, confidence);
+            }
+            break;
+          }
+        }
+      } while (it->Next(tesseract::RIL_TEXTLINE));
+    }
+  }
+
+  for (size_t i = 0; i < pending.size(); ++i) {
+    auto &result = results[pending[i]];
+    // only the crops the batch was unsure about pay for a second call
+    if (!result || result->confidence < profile.retry_below_confidence) {
+      auto single = recognize_prepared(prepared[i], profile);
+      if (!result || single.confidence > result->confidence) {
+        result = std::move(single);
+      }
+    }
+    if (signatures[i]) {
+      cache_store(*signatures[i], *result);
+    }
+  }
+  return results;
 }
 } // namespace dfg
\ No newline at end of file
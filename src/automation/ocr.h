@@ -3,14 +3,115 @@
 #include "tesseract/publictypes.h"
 #include "opencv2/opencv.hpp"
 
+#include <array>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
 namespace dfg {
+// Tesseract settings for one kind of crop. Profiles are applied lazily, so
+// switching between them only costs a few variable writes.
+struct OCRProfile {
+  std::string name;
+  // TessBaseAPI's own default, what recognition used before profiles existed
+  tesseract::PageSegMode psm = tesseract::PSM_SINGLE_BLOCK;
+  // empty means every character is allowed
+  std::string whitelist;
+  // Results with a mean confidence (0-100) below this are retried with an
+  // upscaled and binarized copy of the crop. 0 disables the retry.
+  float retry_below_confidence = 0;
+  // Digit-only crops go to the engine loaded without dictionaries, the
+  // others to the full English model with them.
+  bool digits = false;
+};
+
+namespace ocr_profiles {
+inline const OCRProfile text{"text"};
+inline const OCRProfile price{"price", tesseract::PSM_SINGLE_LINE,
+                              "0123456789,.", 75, true};
+} // namespace ocr_profiles
+
+struct OCRResult {
+  std::string text;
+  float confidence = 0;
+};
+
 struct OCR {
   OCR();
   ~OCR();
-  void initialize();
-  std::optional<std::string> recognize_text_eng(const cv::Mat &image);
+  // Load the engine for digit profiles from ./models/<language>.traineddata,
+  // without dictionaries. The default prefers a trimmed "digits" model when
+  // one is shipped, and falls back to the full English model. The engine for
+  // text profiles is loaded on first use.
+  void initialize(const std::string &language = default_language());
+  static std::string default_language();
+  std::optional<OCRResult>
+  recognize_text_eng(const cv::Mat &image,
+                     const OCRProfile &profile = ocr_profiles::text);
+  // Same as recognize_text_eng, but keeps only the digits of the result.
+  std::optional<int>
+  recognize_int_eng(const cv::Mat &image,
+                    const OCRProfile &profile = ocr_profiles::price);
+  // Recognize several single-line crops with one Tesseract call. The crops are
+  // stacked into one tall image with blank separator rows, and every text line
+  // found is mapped back to the crop whose row span contains it. The result
+  // has one entry per input crop, empty if no line landed in it. The page
+  // segmentation mode of the profile is replaced by single-column mode.
+  std::vector<std::optional<OCRResult>>
+  recognize_batch_eng(const std::vector<cv::Mat> &images,
+                      const OCRProfile &profile = ocr_profiles::text);
+
+  static std::optional<int> parse_int(const std::string &text);
+
+  // Results are cached by a signature of the binarized crop, so a price that
+  // renders identically is only recognized once.
+  struct CacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    // low-confidence results that were recognized a second time
+    size_t retries = 0;
+  };
+  CacheStats cache_stats() const {
+    std::lock_guard lock(api_mutex);
+    return stats;
+  }
+  size_t cache_capacity = 1024;
 
 private:
-  std::unique_ptr<tesseract::TessBaseAPI> api;
+  // 128x16 bits of the ink bounding box, the box size and the profile
+  using CropSignature = std::array<uint64_t, 34>;
+  struct CropSignatureHash {
+    size_t operator()(const CropSignature &sig) const;
+  };
+  static std::optional<CropSignature> signature(const cv::Mat &prepared,
+                                                const OCRProfile &profile);
+  std::optional<OCRResult> cache_lookup(const CropSignature &sig);
+  void cache_store(const CropSignature &sig, const OCRResult &result);
+
+  struct Engine {
+    std::unique_ptr<tesseract::TessBaseAPI> api;
+    std::string applied_whitelist;
+  };
+  // Load ./models/<language>.traineddata from a memory-mapped file, Tesseract
+  // keeps its own copy of the model.
+  static void load(Engine &engine, const std::string &language,
+                   bool dictionaries);
+  // the engine for the profile, loaded and set up for it
+  tesseract::TessBaseAPI &apply_profile(const OCRProfile &profile,
+                                        tesseract::PageSegMode psm);
+  OCRResult recognize_prepared(const cv::Mat &prepared,
+                               const OCRProfile &profile);
+
+  std::list<std::pair<CropSignature, OCRResult>> cache_lru;
+  std::unordered_map<CropSignature, decltype(cache_lru)::iterator,
+                     CropSignatureHash>
+      cache_index;
+  CacheStats stats;
+
+  // Tesseract and the cache are single-threaded, recognition may be called
+  // from the vision pool
+  mutable std::mutex api_mutex;
+  Engine digits_engine;
+  Engine text_engine;
 };
-} // namespace dfg
\ No newline at end of file
+} // namespace dfg
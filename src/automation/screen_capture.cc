@@ -1,7 +1,9 @@
 #include "screen_capture.h"
+#include "input_simulator.h"
 
 #include <Windows.Graphics.Capture.Interop.h>
 #include <d3d11_4.h>
+#include <dwmapi.h>
 #include <dxgi1_6.h>
 #include <winrt/Windows.Foundation.h>
 #include <winrt/Windows.Graphics.Capture.h>
@@ -9,8 +11,10 @@
 #include <winrt/Windows.Graphics.DirectX.h>
 #include <winrt/Windows.System.h>
 
+#include <algorithm>
 #include <atomic>
 #include <mutex>
+#include <vector>
 
 struct __declspec(uuid(
     "A9B3D012-3DF2-4EE3-B8D1-8695F457D3C1")) IDirect3DDxgiInterfaceAccess
@@ -87,98 +91,336 @@ static auto create_capture_item_for_monitor(HMONITOR hmonitor) {
   return item;
 }
 
-cv::Mat capture_internal(
-    winrt::Windows::Graphics::Capture::GraphicsCaptureItem const &item) {
-  if (!item) {
-    return cv::Mat();
-  }
+static auto create_d3d11_devices() {
+  struct Devices {
+    winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice direct;
+    winrt::com_ptr<ID3D11Device> d3d11;
+  };
+  auto direct = create_d3d11_device();
+  return Devices{direct, get_dxgi_interface<ID3D11Device>(direct)};
+}
+
+static auto &d3d11_devices() {
+  static auto devices = create_d3d11_devices();
+  return devices;
+}
+
+// The immediate context is not thread safe, and borrowed frames unmap from
+// whichever thread drops them.
+static std::mutex &d3d11_context_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
 
-  static winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice
-      d3d11_direct_device = create_d3d11_device();
-  static winrt::com_ptr<ID3D11Device> d3d11_device =
-      get_dxgi_interface<ID3D11Device>(d3d11_direct_device);
-  winrt::com_ptr<ID3D11DeviceContext> d3d11_device_context;
-  d3d11_device->GetImmediateContext(d3d11_device_context.put());
-
-  auto frame_pool =
-      winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool::Create(
-          d3d11_direct_device,
-          winrt::Windows::Graphics::DirectX::DirectXPixelFormat::
-              B8G8R8A8UIntNormalized,
-          1, item.Size());
-
-  auto session = frame_pool.CreateCaptureSession(item);
-  session.StartCapture();
-
-  winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame frame = nullptr;
-  for (int i = 0; i < 100; ++i) {
-    frame = frame_pool.TryGetNextFrame();
-    if (frame) {
-      break;
+static auto d3d11_context() {
+  winrt::com_ptr<ID3D11DeviceContext> context;
+  d3d11_devices().d3d11->GetImmediateContext(context.put());
+  return context;
+}
+
+// A staging texture and whether a BorrowedFrame still has it mapped.
+struct StagingTexture {
+  winrt::com_ptr<ID3D11Texture2D> texture;
+  std::shared_ptr<std::atomic<bool>> borrowed =
+      std::make_shared<std::atomic<bool>>(false);
+};
+
+struct BorrowedFrame::Mapping {
+  winrt::com_ptr<ID3D11Texture2D> texture;
+  std::shared_ptr<std::atomic<bool>> borrowed;
+
+  ~Mapping() {
+    {
+      std::lock_guard lock(d3d11_context_mutex());
+      d3d11_context()->Unmap(texture.get(), 0);
     }
-    Sleep(10);
+    borrowed->store(false);
   }
+};
+
+BorrowedFrame::BorrowedFrame() = default;
 
-  if (!frame) {
+BorrowedFrame::BorrowedFrame(cv::Mat owned, int64_t timestamp)
+    : pixels(std::move(owned)), time(timestamp) {}
+
+BorrowedFrame::BorrowedFrame(cv::Mat mapped, int64_t timestamp,
+                             std::unique_ptr<Mapping> mapping)
+    : pixels(std::move(mapped)), time(timestamp), mapping(std::move(mapping)) {
+}
+
+BorrowedFrame::BorrowedFrame(BorrowedFrame &&other) noexcept
+    : pixels(std::move(other.pixels)), time(other.time),
+      mapping(std::move(other.mapping)) {}
+
+BorrowedFrame &BorrowedFrame::operator=(BorrowedFrame &&other) noexcept {
+  if (this != &other) {
+    release();
+    pixels = std::move(other.pixels);
+    time = other.time;
+    mapping = std::move(other.mapping);
+  }
+  return *this;
+}
+
+BorrowedFrame::~BorrowedFrame() { release(); }
+
+void BorrowedFrame::release() {
+  // the header must not outlive the mapped memory it points into
+  pixels.release();
+  mapping.reset();
+}
+
+// The client area of window within its captured frame. Window capture covers
+// the visible frame bounds, title bar and borders included, while everything
+// else (WindowGeometry, the develop resolution) describes the client area.
+// Without a window, e.g. for a monitor, the whole frame.
+static cv::Rect client_area(HWND window, cv::Size frame_size) {
+  auto frame_rect = cv::Rect({}, frame_size);
+  RECT client, bounds;
+  POINT origin = {0, 0};
+  if (!window || !GetClientRect(window, &client) ||
+      !ClientToScreen(window, &origin)) {
+    return frame_rect;
+  }
+  if (FAILED(DwmGetWindowAttribute(window, DWMWA_EXTENDED_FRAME_BOUNDS,
+                                   &bounds, sizeof(bounds))) &&
+      !GetWindowRect(window, &bounds)) {
+    return frame_rect;
+  }
+  return cv::Rect(origin.x - bounds.left, origin.y - bounds.top,
+                  client.right - client.left, client.bottom - client.top) &
+         frame_rect;
+}
+
+// A capture session kept alive between captures. Creating the frame pool and
+// starting the session is the expensive part of a capture, so it is done once
+// per target and the pool is only drained on every capture.
+struct ScreenCapture::Session {
+  winrt::Windows::Graphics::Capture::GraphicsCaptureItem item{nullptr};
+  // the captured window, null for a monitor
+  HWND window = nullptr;
+  winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool frame_pool{
+      nullptr};
+  winrt::Windows::Graphics::Capture::GraphicsCaptureSession session{nullptr};
+  winrt::Windows::Graphics::SizeInt32 size{};
+  // The newest frame received, kept open so a window that stops changing can
+  // still be captured: the capture API only delivers a frame when the content
+  // changes. The pool has room for a second frame meanwhile.
+  winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame current{nullptr};
+  static constexpr int32_t pool_frames = 2;
+  // staging textures by copy size, i.e. the full frame and a few ROIs, with
+  // more than one per size while frames of that size are borrowed
+  std::vector<StagingTexture> staging_textures;
+
+  explicit Session(
+      winrt::Windows::Graphics::Capture::GraphicsCaptureItem const &item,
+      HWND window = nullptr)
+      : item(item), window(window), size(item.Size()) {
+    frame_pool = winrt::Windows::Graphics::Capture::
+        Direct3D11CaptureFramePool::CreateFreeThreaded(
+            d3d11_devices().direct,
+            winrt::Windows::Graphics::DirectX::DirectXPixelFormat::
+                B8G8R8A8UIntNormalized,
+            pool_frames, size);
+    session = frame_pool.CreateCaptureSession(item);
+    session.StartCapture();
+  }
+
+  ~Session() {
+    if (current) {
+      current.Close();
+    }
     session.Close();
     frame_pool.Close();
-    return cv::Mat();
   }
 
-  auto frame_captured_texture =
-      get_dxgi_interface<ID3D11Texture2D>(frame.Surface());
-
-  D3D11_TEXTURE2D_DESC desc;
-  frame_captured_texture->GetDesc(&desc);
-
-  D3D11_TEXTURE2D_DESC map_desc = {};
-  map_desc.Width = desc.Width;
-  map_desc.Height = desc.Height;
-  map_desc.MipLevels = 1;
-  map_desc.ArraySize = 1;
-  map_desc.Format = desc.Format;
-  map_desc.SampleDesc.Count = 1;
-  map_desc.Usage = D3D11_USAGE_STAGING;
-  map_desc.BindFlags = 0;
-  map_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-  map_desc.MiscFlags = 0;
-
-  winrt::com_ptr<ID3D11Texture2D> mapped_texture;
-  winrt::check_hresult(
-      d3d11_device->CreateTexture2D(&map_desc, nullptr, mapped_texture.put()));
+  // Moves current to the newest frame the pool holds.
+  void drain() {
+    while (auto frame = frame_pool.TryGetNextFrame()) {
+      if (current) {
+        current.Close();
+        current = nullptr;
+      }
+      if (frame.ContentSize() != size) {
+        size = frame.ContentSize();
+        frame.Close();
+        frame_pool.Recreate(d3d11_devices().direct,
+                            winrt::Windows::Graphics::DirectX::
+                                DirectXPixelFormat::B8G8R8A8UIntNormalized,
+                            pool_frames, size);
+        continue;
+      }
+      current = frame;
+    }
+  }
 
-  d3d11_device_context->CopyResource(mapped_texture.get(),
-                                     frame_captured_texture.get());
+  // The newest frame. One rendered before the last input may be stale, so
+  // a newer one is waited for briefly; a window that does not change sends
+  // none, and then the newest buffered frame is returned anyway. Its
+  // timestamp tells callers how fresh it is. Stays owned by the session.
+  winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame next_frame() {
+    auto input_time = InputSimulator::last_epoch().time;
+    auto fresh = [&] {
+      return current && current.SystemRelativeTime().count() > input_time;
+    };
+    drain();
+    for (int i = 0; i < 100 && !fresh(); ++i) {
+      Sleep(1);
+      drain();
+    }
+    return current;
+  }
 
-  D3D11_MAPPED_SUBRESOURCE map_result;
-  winrt::check_hresult(d3d11_device_context->Map(
-      mapped_texture.get(), 0, D3D11_MAP_READ, 0, &map_result));
+  StagingTexture &staging_for(UINT width, UINT height, DXGI_FORMAT format) {
+    for (auto &staging : staging_textures) {
+      D3D11_TEXTURE2D_DESC current;
+      staging.texture->GetDesc(&current);
+      if (current.Width == width && current.Height == height &&
+          current.Format == format && !staging.borrowed->load()) {
+        return staging;
+      }
+    }
+
+    // evict the oldest texture nobody borrows, a borrowed one is kept alive
+    // by its BorrowedFrame anyway
+    constexpr size_t max_staging_textures = 8;
+    if (staging_textures.size() >= max_staging_textures) {
+      auto unused = std::ranges::find_if(staging_textures, [](auto &staging) {
+        return !staging.borrowed->load();
+      });
+      staging_textures.erase(unused != staging_textures.end()
+                                 ? unused
+                                 : staging_textures.begin());
+    }
 
-  cv::Mat image(desc.Height, desc.Width, CV_8UC4);
+    D3D11_TEXTURE2D_DESC map_desc = {};
+    map_desc.Width = width;
+    map_desc.Height = height;
+    map_desc.MipLevels = 1;
+    map_desc.ArraySize = 1;
+    map_desc.Format = format;
+    map_desc.SampleDesc.Count = 1;
+    map_desc.Usage = D3D11_USAGE_STAGING;
+    map_desc.BindFlags = 0;
+    map_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    map_desc.MiscFlags = 0;
 
-  for (UINT y = 0; y < desc.Height; ++y) {
-    memcpy(image.ptr(y),
-           reinterpret_cast<BYTE *>(map_result.pData) + y * map_result.RowPitch,
-           desc.Width * 4);
+    StagingTexture staging;
+    winrt::check_hresult(d3d11_devices().d3d11->CreateTexture2D(
+        &map_desc, nullptr, staging.texture.put()));
+    return staging_textures.emplace_back(std::move(staging));
   }
 
-  d3d11_device_context->Unmap(mapped_texture.get(), 0);
+  BorrowedFrame capture(std::optional<cv::Rect> roi = std::nullopt) {
+    auto frame = next_frame();
+    if (!frame) {
+      return {};
+    }
+    auto frame_time = frame.SystemRelativeTime().count();
+
+    auto frame_captured_texture =
+        get_dxgi_interface<ID3D11Texture2D>(frame.Surface());
 
-  session.Close();
-  frame_pool.Close();
+    D3D11_TEXTURE2D_DESC desc;
+    frame_captured_texture->GetDesc(&desc);
 
-  return image;
-}
+    // only the ROI leaves the GPU, the rest of the frame is never copied;
+    // the ROI is relative to the client area, which is all that is copied
+    // without one
+    auto client = client_area(window, cv::Size(desc.Width, desc.Height));
+    auto region = client;
+    if (roi) {
+      region = (*roi + client.tl()) & client;
+    }
+    if (region.empty()) {
+      return {};
+    }
+
+    auto &staging = staging_for(region.width, region.height, desc.Format);
+    D3D11_MAPPED_SUBRESOURCE map_result;
+    {
+      std::lock_guard lock(d3d11_context_mutex());
+      auto d3d11_device_context = d3d11_context();
+      if (roi) {
+        D3D11_BOX box = {UINT(region.x),
+                         UINT(region.y),
+                         0,
+                         UINT(region.x + region.width),
+                         UINT(region.y + region.height),
+                         1};
+        d3d11_device_context->CopySubresourceRegion(
+            staging.texture.get(), 0, 0, 0, 0, frame_captured_texture.get(),
+            0, &box);
+      } else {
+        d3d11_device_context->CopyResource(staging.texture.get(),
+                                           frame_captured_texture.get());
+      }
+
+      winrt::check_hresult(d3d11_device_context->Map(
+          staging.texture.get(), 0, D3D11_MAP_READ, 0, &map_result));
+    }
+
+    // the mapped rows are RowPitch apart, which the Mat's step carries
+    staging.borrowed->store(true);
+    return BorrowedFrame(cv::Mat(region.height, region.width, CV_8UC4,
+                                 map_result.pData, map_result.RowPitch),
+                         frame_time,
+                         std::make_unique<BorrowedFrame::Mapping>(
+                             staging.texture, staging.borrowed));
+  }
+};
+
+ScreenCapture::ScreenCapture() = default;
+ScreenCapture::~ScreenCapture() = default;
 
 cv::Mat ScreenCapture::capture_screen() {
 
   POINT pt = {0, 0};
   HMONITOR hmonitor = MonitorFromPoint(pt, MONITOR_DEFAULTTOPRIMARY);
-  return capture_internal(create_capture_item_for_monitor(hmonitor));
+  auto item = create_capture_item_for_monitor(hmonitor);
+  if (!item) {
+    return cv::Mat();
+  }
+  return buffers.copy(Session(item).capture().image());
+}
+
+void ScreenCapture::warm_up(HWND hwnd) {
+  std::lock_guard lock(session_mutex);
+  session_for(hwnd);
+}
+
+ScreenCapture::Session &ScreenCapture::session_for(HWND hwnd) {
+  if (session && session_hwnd == hwnd) {
+    return *session;
+  }
+  session.reset();
+  auto item = create_capture_item_for_window(hwnd);
+  if (!item) {
+    throw std::runtime_error("Failed to create capture item for window");
+  }
+  session = std::make_unique<Session>(item, hwnd);
+  session_hwnd = hwnd;
+  return *session;
+}
+
+cv::Mat ScreenCapture::capture_window(HWND hwnd, std::optional<cv::Rect> roi,
+                                      int64_t *frame_time) {
+  auto borrowed = borrow_window(hwnd, roi);
+  if (frame_time) {
+    *frame_time = borrowed.timestamp();
+  }
+  if (borrowed.empty()) {
+    return cv::Mat();
+  }
+  return buffers.copy(borrowed.image());
 }
 
-cv::Mat ScreenCapture::capture_window(HWND hwnd) {
-  return capture_internal(create_capture_item_for_window(hwnd));
+BorrowedFrame ScreenCapture::borrow_window(HWND hwnd,
+                                           std::optional<cv::Rect> roi) {
+  // one lock for the check and the capture, so another thread cannot
+  // replace the session in between
+  std::lock_guard lock(session_mutex);
+  return session_for(hwnd).capture(roi);
 }
 
 } // namespace dfg
\ No newline at end of file
@@ -1,23 +1,87 @@
 #pragma once
 
 #include <windows.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 #include <opencv2/opencv.hpp> 
 
+#include "frame_buffer_pool.h"
+
 namespace dfg {
 
+// A captured frame read in place from the mapped staging texture, nothing is
+// copied. image() has the texture's row pitch as step and is only valid while
+// the BorrowedFrame lives; the staging texture is not reused for other
+// captures until then. Copy out whatever has to outlive it.
+class BorrowedFrame {
+public:
+    // The mapped staging texture, only defined by the capture backend.
+    struct Mapping;
+
+    BorrowedFrame();
+    // Wraps an image that is owned already, e.g. one that had to be resized.
+    explicit BorrowedFrame(cv::Mat owned, int64_t timestamp = 0);
+    // Takes over mapped memory, unmapped when the frame goes away.
+    BorrowedFrame(cv::Mat mapped, int64_t timestamp,
+                  std::unique_ptr<Mapping> mapping);
+    BorrowedFrame(BorrowedFrame &&other) noexcept;
+    BorrowedFrame &operator=(BorrowedFrame &&other) noexcept;
+    ~BorrowedFrame();
+
+    bool empty() const { return pixels.empty(); }
+    const cv::Mat &image() const { return pixels; }
+    // the frame's SystemRelativeTime, see InputEpoch
+    int64_t timestamp() const { return time; }
+
+private:
+    void release();
+
+    cv::Mat pixels;
+    int64_t time = 0;
+    std::unique_ptr<Mapping> mapping;
+};
+
 class ScreenCapture {
 public:
-    ScreenCapture() = default;
-    ~ScreenCapture() = default;
+    ScreenCapture();
+    ~ScreenCapture();
 
     cv::Mat capture_screen();
 
-    cv::Mat capture_window(HWND hwnd);
+    // Captures the window's client area, the rect WindowGeometry describes.
+    // With roi, only that part of it (in client pixels) is copied back from
+    // the GPU. frame_time receives the frame's SystemRelativeTime,
+    // comparable with InputEpoch::time. The result lives in a pooled buffer,
+    // see buffer_pool().
+    cv::Mat capture_window(HWND hwnd,
+                           std::optional<cv::Rect> roi = std::nullopt,
+                           int64_t *frame_time = nullptr);
+    // Same as capture_window without the copy out of the staging texture.
+    // Staging textures rotate, so a few borrowed frames of the same size can
+    // be alive at once, e.g. the previous and the current one.
+    BorrowedFrame borrow_window(HWND hwnd,
+                                std::optional<cv::Rect> roi = std::nullopt);
+
+    // Start the capture session for hwnd ahead of the first capture_window.
+    void warm_up(HWND hwnd);
+
+    // Where captured frames, and the views derived from them, get their
+    // buffers from. Its stats show whether capturing still allocates.
+    FrameBufferPool &buffer_pool() { return buffers; }
 
 private:
-    
+    struct Session;
+    // The session capturing hwnd, created if needed. session_mutex must be
+    // held.
+    Session &session_for(HWND hwnd);
+    std::mutex session_mutex;
+    std::unique_ptr<Session> session;
+    HWND session_hwnd = nullptr;
+    FrameBufferPool buffers;
 };
 
-} 
\ No newline at end of file
+} 
@@ -0,0 +1,129 @@
+#include "window_geometry.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace dfg {
+
+void WindowGeometry::attach(
+    std::unique_ptr<WindowGeometryProvider> geometry_provider) {
+  std::lock_guard lock(mutex);
+  provider = std::move(geometry_provider);
+  valid = false;
+}
+
+void WindowGeometry::invalidate() {
+  std::lock_guard lock(mutex);
+  valid = false;
+}
+
+void WindowGeometry::sync() {
+  if (!provider) {
+    throw std::runtime_error("Window geometry has no provider");
+  }
+  auto generation = provider->generation();
+  if (valid && generation == seen_generation) {
+    return;
+  }
+
+  auto rect = provider->query();
+  if (!rect || rect->width <= 0 || rect->height <= 0) {
+    throw std::runtime_error("Failed to get window rect");
+  }
+  current = *rect;
+  origin = cv::Point2f(static_cast<float>(rect->x), static_cast<float>(rect->y));
+  to_logical_scale =
+      cv::Point2f(static_cast<float>(develop_size.width) / rect->width,
+                  static_cast<float>(develop_size.height) / rect->height);
+  to_screen_scale =
+      cv::Point2f(1 / to_logical_scale.x, 1 / to_logical_scale.y);
+  seen_generation = generation;
+  valid = true;
+  refresh_count++;
+}
+
+WindowRect WindowGeometry::rect() {
+  std::lock_guard lock(mutex);
+  sync();
+  return current;
+}
+
+cv::Point2f WindowGeometry::scales() {
+  std::lock_guard lock(mutex);
+  sync();
+  return to_logical_scale;
+}
+
+float WindowGeometry::scale() { return scales().x; }
+
+cv::Point WindowGeometry::to_screen(cv::Point logical) {
+  std::lock_guard lock(mutex);
+  sync();
+  return {static_cast<int>(origin.x + logical.x * to_screen_scale.x),
+          static_cast<int>(origin.y + logical.y * to_screen_scale.y)};
+}
+
+cv::Point WindowGeometry::to_logical(cv::Point screen) {
+  std::lock_guard lock(mutex);
+  sync();
+  return {static_cast<int>((screen.x - origin.x) * to_logical_scale.x),
+          static_cast<int>((screen.y - origin.y) * to_logical_scale.y)};
+}
+
+size_t WindowGeometry::refreshes() {
+  std::lock_guard lock(mutex);
+  return refresh_count;
+}
+
+#ifdef _WIN32
+namespace {
+class Win32GeometryProvider : public WindowGeometryProvider {
+public:
+  Win32GeometryProvider(HWND window, std::chrono::milliseconds poll_interval)
+      : window(window), poll_interval(poll_interval) {}
+
+  std::optional<WindowRect> query() override {
+    RECT rect;
+    POINT origin{0, 0};
+    if (!GetClientRect(window, &rect) || !ClientToScreen(window, &origin)) {
+      return {};
+    }
+    return WindowRect{origin.x, origin.y, rect.right - rect.left,
+                      rect.bottom - rect.top};
+  }
+
+  uint64_t generation() override {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_poll < poll_interval) {
+      return current_generation;
+    }
+    last_poll = now;
+    auto rect = query();
+    if (rect != last_rect) {
+      last_rect = rect;
+      current_generation++;
+    }
+    return current_generation;
+  }
+
+private:
+  HWND window;
+  std::chrono::milliseconds poll_interval;
+  std::chrono::steady_clock::time_point last_poll;
+  std::optional<WindowRect> last_rect;
+  uint64_t current_generation = 0;
+};
+} // namespace
+
+std::unique_ptr<WindowGeometryProvider>
+make_win32_geometry_provider(void *window,
+                             std::chrono::milliseconds poll_interval) {
+  return std::make_unique<Win32GeometryProvider>(static_cast<HWND>(window),
+                                                 poll_interval);
+}
+#endif
+
+} // namespace dfg
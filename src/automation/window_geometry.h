@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <opencv2/core.hpp>
+
+namespace dfg {
+
+// Position and size of the window's client area in screen pixels.
+struct WindowRect {
+  int x = 0, y = 0, width = 0, height = 0;
+  bool operator==(const WindowRect &) const = default;
+};
+
+// Where WindowGeometry gets the window from. The Win32 provider reads the
+// real window; anything else (a fake window in a test, a replay) only needs
+// these two calls.
+class WindowGeometryProvider {
+public:
+  virtual ~WindowGeometryProvider() = default;
+  // Current rect, nullopt if the window is gone.
+  virtual std::optional<WindowRect> query() = 0;
+  // Changes whenever the window may have moved or resized. Called on every
+  // transform, so it has to be cheap.
+  virtual uint64_t generation() = 0;
+};
+
+// Reads the client area with GetClientRect and ClientToScreen, so borders and
+// the title bar never enter the scale; ScreenCapture crops window frames to
+// the same area. The rect is polled at most once per poll_interval,
+// generation() only moves when it actually changed. window is an HWND.
+std::unique_ptr<WindowGeometryProvider>
+make_win32_geometry_provider(void *window,
+                             std::chrono::milliseconds poll_interval =
+                                 std::chrono::milliseconds(250));
+
+// Cached window geometry and the transform between logical coordinates (the
+// develop resolution every template and offset is authored in) and screen
+// pixels. The cache is only refreshed when the provider reports a new
+// generation.
+class WindowGeometry {
+public:
+  explicit WindowGeometry(cv::Size develop_size) : develop_size(develop_size) {}
+
+  void attach(std::unique_ptr<WindowGeometryProvider> geometry_provider);
+  // Forces a refresh on the next call, e.g. after moving the window itself.
+  void invalidate();
+
+  WindowRect rect();
+  // From the real window size to the develop size, per axis. The bigger the
+  // window is, the smaller the scale is.
+  cv::Point2f scales();
+  // The horizontal scale, used for images, which keep their aspect ratio.
+  float scale();
+  cv::Point to_screen(cv::Point logical);
+  cv::Point to_logical(cv::Point screen);
+  // How often the cached geometry was re-read.
+  size_t refreshes();
+
+private:
+  // Expects mutex to be held.
+  void sync();
+
+  std::mutex mutex;
+  cv::Size develop_size;
+  std::unique_ptr<WindowGeometryProvider> provider;
+  bool valid = false;
+  uint64_t seen_generation = 0;
+  size_t refresh_count = 0;
+  WindowRect current;
+  // logical to screen, per axis: screen = origin + logical * to_screen_scale
+  cv::Point2f origin;
+  cv::Point2f to_logical_scale{1, 1};
+  cv::Point2f to_screen_scale{1, 1};
+};
+
+} // namespace dfg
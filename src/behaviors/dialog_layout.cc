@@ -0,0 +1,91 @@
+#include "dialog_layout.h"
+#include "../main.h"
+
+namespace dfg {
+static constexpr float dialog_match_threshold = 0.7f;
+
+Task<std::optional<cv::Rect>> DialogLayout::open(int max_wait,
+                                                 InputEpoch after) {
+  anchor_rect.reset();
+  auto start_time = std::chrono::steady_clock::now();
+  co_await schedule_on(app.runtime.pool, Priority::Interactive, "dialog");
+  for (bool first = true;; first = false) {
+    auto frame = app.capture_frame(first);
+    if (frame.timestamp() <= after.time) {
+      if (std::chrono::steady_clock::now() - start_time >
+          std::chrono::milliseconds(max_wait)) {
+        co_return std::nullopt;
+      }
+      continue;
+    }
+    if (last_anchor_rect &&
+        app.image_at(frame, anchor, *last_anchor_rect,
+                     dialog_match_threshold)) {
+      layout_stats.derived++;
+      anchor_rect = last_anchor_rect;
+      co_return anchor_rect;
+    }
+
+    if (auto rect =
+            app.locate_image_rect(frame, anchor, dialog_match_threshold)) {
+      layout_stats.searched++;
+      anchor_rect = last_anchor_rect = rect;
+      co_return anchor_rect;
+    }
+
+    if (std::chrono::steady_clock::now() - start_time >
+        std::chrono::milliseconds(max_wait)) {
+      co_return std::nullopt;
+    }
+    co_await sleep_for(app.runtime.timers, std::chrono::milliseconds(10));
+  }
+}
+
+std::optional<cv::Rect> DialogLayout::locate(const std::string &path,
+                                             const FrameContext &frame,
+                                             float threshold) {
+  if (anchor_rect) {
+    if (auto it = offsets.find(path); it != offsets.end()) {
+      auto derived = it->second + anchor_rect->tl();
+      if (app.image_at(frame, path, derived, threshold)) {
+        layout_stats.derived++;
+        return derived;
+      }
+    }
+  }
+
+  auto rect = app.locate_image_rect(frame, path, threshold);
+  if (!rect) {
+    return {};
+  }
+  layout_stats.searched++;
+  if (anchor_rect) {
+    offsets[path] = *rect - anchor_rect->tl();
+  }
+  return rect;
+}
+
+Task<std::optional<cv::Rect>>
+DialogLayout::wait_for(std::string path, int max_wait, float threshold) {
+  auto start_time = std::chrono::steady_clock::now();
+  co_await schedule_on(app.runtime.pool, Priority::Interactive, "dialog");
+  for (bool first = true;; first = false) {
+    if (auto rect = locate(path, app.capture_frame(first), threshold)) {
+      co_return rect;
+    }
+    if (std::chrono::steady_clock::now() - start_time >
+        std::chrono::milliseconds(max_wait)) {
+      co_return std::nullopt;
+    }
+    co_await sleep_for(app.runtime.timers, std::chrono::milliseconds(10));
+  }
+}
+
+Task<std::optional<cv::Rect>> DialogLayout::open_for(std::string path,
+                                                     int max_wait) {
+  if (!co_await open(max_wait)) {
+    co_return std::nullopt;
+  }
+  co_return co_await wait_for(std::move(path), max_wait);
+}
+} // namespace dfg
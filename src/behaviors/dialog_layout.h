@@ -0,0 +1,59 @@
+#pragma once
+#include "../automation/frame_context.h"
+#include "../automation/input_simulator.h"
+#include "../runtime/task.hpp"
+#include "opencv2/opencv.hpp"
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace dfg {
+struct App;
+
+// Element positions inside one dialog, learned relative to an anchor image.
+// Each time the dialog opens only the anchor is searched for (and even that
+// is first tried at its last position). Other elements are derived from their
+// learned offsets and confirmed with a same-size match at the expected spot.
+// A full search only runs when that confirmation fails. The waits are
+// awaitable: matching runs on the vision pool, and the polling interval
+// suspends on the runtime's timers instead of blocking a thread.
+struct DialogLayout {
+  App &app;
+  std::string anchor;
+
+  struct Stats {
+    // elements confirmed at a derived position
+    size_t derived = 0;
+    // elements that needed a full-frame search
+    size_t searched = 0;
+  };
+
+  DialogLayout(App &app, std::string anchor)
+      : app(app), anchor(std::move(anchor)) {}
+
+  // Waits for the dialog to appear and returns the anchor rect. Frames
+  // rendered before the input epoch that opens the dialog are not looked at.
+  Task<std::optional<cv::Rect>> open(int max_wait = 1000,
+                                     InputEpoch after = {});
+  // Element rect in the currently open dialog, as seen in frame.
+  std::optional<cv::Rect> locate(const std::string &path,
+                                 const FrameContext &frame,
+                                 float threshold = 0.7f);
+  // Like locate, but keeps capturing until the element shows up.
+  Task<std::optional<cv::Rect>> wait_for(std::string path, int max_wait = 1000,
+                                         float threshold = 0.7f);
+  // open() followed by wait_for(path), nullopt if the dialog never opened.
+  Task<std::optional<cv::Rect>> open_for(std::string path,
+                                         int max_wait = 1000);
+
+  Stats stats() const { return layout_stats; }
+
+private:
+  std::optional<cv::Rect> anchor_rect;
+  std::optional<cv::Rect> last_anchor_rect;
+  // element rect relative to the anchor's top-left corner
+  std::unordered_map<std::string, cv::Rect> offsets;
+  Stats layout_stats;
+};
+} // namespace dfg
@@ -0,0 +1,135 @@
+#include "item_index.h"
+
+#include <bit>
+#include <fstream>
+#include <print>
+
+namespace dfg {
+ItemFingerprint ItemFingerprint::of(const cv::Mat &item_img, int width,
+                                    int height, int quality) {
+  cv::Mat gray, small;
+  cv::cvtColor(item_img, gray, cv::COLOR_BGR2GRAY);
+  cv::resize(gray, small, cv::Size(17, 16), 0, 0, cv::INTER_AREA);
+
+  ItemFingerprint fingerprint;
+  fingerprint.width = width;
+  fingerprint.height = height;
+  fingerprint.quality = quality;
+  for (int y = 0; y < 16; ++y) {
+    auto row = small.ptr<uint8_t>(y);
+    for (int x = 0; x < 16; ++x) {
+      if (row[x] < row[x + 1]) {
+        int bit = y * 16 + x;
+        fingerprint.icon_hash[bit / 64] |= 1ull << (bit % 64);
+      }
+    }
+  }
+  return fingerprint;
+}
+
+int ItemFingerprint::distance(const ItemFingerprint &other) const {
+  int bits = 0;
+  for (size_t i = 0; i < icon_hash.size(); ++i) {
+    bits += std::popcount(icon_hash[i] ^ other.icon_hash[i]);
+  }
+  return bits;
+}
+
+static constexpr int item_index_version = 3;
+
+static uint64_t mix(uint64_t key) {
+  // splitmix64 finalizer
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ull;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebull;
+  key ^= key >> 31;
+  return key;
+}
+
+void ItemIndex::load() {
+  entries.clear();
+  ids.clear();
+  std::ifstream in(path);
+  if (!in) {
+    return;
+  }
+
+  std::string magic;
+  int version = 0;
+  if (!(in >> magic >> version) || magic != "item_index" ||
+      version != item_index_version) {
+    std::println("[item_index] {} has an old format, ignored", path.string());
+    return;
+  }
+
+  size_t count = 0;
+  Entry entry;
+  auto &fp = entry.fingerprint;
+  while (in >> fp.width >> fp.height >> fp.quality >> fp.icon_hash[0] >>
+         fp.icon_hash[1] >> fp.icon_hash[2] >> fp.icon_hash[3] >> entry.id) {
+    entries[footprint_key(fp)].push_back(entry);
+    ids.insert(entry.id);
+    count++;
+  }
+  std::println("[item_index] loaded {} items from {}", count, path.string());
+}
+
+void ItemIndex::save() const {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream out(path, std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Failed to write item index: " + path.string());
+  }
+
+  std::println(out, "item_index {}", item_index_version);
+  for (const auto &[key, bucket] : entries) {
+    for (const auto &entry : bucket) {
+      const auto &fp = entry.fingerprint;
+      std::println(out, "{} {} {} {} {} {} {} {}", fp.width, fp.height,
+                   fp.quality, fp.icon_hash[0], fp.icon_hash[1],
+                   fp.icon_hash[2], fp.icon_hash[3], entry.id);
+    }
+  }
+}
+
+const ItemIndex::Entry *
+ItemIndex::find(const ItemFingerprint &fingerprint) const {
+  auto it = entries.find(footprint_key(fingerprint));
+  if (it == entries.end()) {
+    return nullptr;
+  }
+
+  const Entry *best = nullptr;
+  int best_distance = max_distance + 1;
+  for (const auto &entry : it->second) {
+    int distance = entry.fingerprint.distance(fingerprint);
+    if (distance < best_distance) {
+      best = &entry;
+      best_distance = distance;
+    }
+  }
+  return best;
+}
+
+uint64_t ItemIndex::record(const ItemFingerprint &fingerprint) {
+  if (auto existing = find(fingerprint)) {
+    return existing->id;
+  }
+
+  Entry entry;
+  entry.fingerprint = fingerprint;
+  // every hash bit and the footprint, quality included, go into the id
+  uint64_t id = mix(footprint_key(fingerprint));
+  for (auto word : fingerprint.icon_hash) {
+    id = mix(id ^ word);
+  }
+  // similar icons can still collide, the next free id keeps them apart
+  while (!ids.insert(id).second) {
+    id++;
+  }
+  entry.id = id;
+  entries[footprint_key(fingerprint)].push_back(entry);
+  return entry.id;
+}
+} // namespace dfg
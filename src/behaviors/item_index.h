@@ -0,0 +1,66 @@
+#pragma once
+#include "opencv2/opencv.hpp"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace dfg {
+// Compact identity of an item as it looks in the warehouse grid: a gradient
+// hash of the icon plus the number of cells it covers and its quality. Items
+// of different quality can share an icon but never an identity.
+struct ItemFingerprint {
+  // 256 bit difference hash of the 17x16 downsampled gray icon
+  std::array<uint64_t, 4> icon_hash{};
+  int width = 0, height = 0;
+  int quality = 0;
+
+  static ItemFingerprint of(const cv::Mat &item_img, int width, int height,
+                            int quality);
+  int distance(const ItemFingerprint &other) const;
+};
+
+// Persistent map from item fingerprints to a stable item identity, so items
+// seen in an earlier run can be recognized without opening the sell dialog.
+// Prices for an identity live in the PriceStore.
+struct ItemIndex {
+  struct Entry {
+    ItemFingerprint fingerprint;
+    // stable identity of the item, a hash of the whole fingerprint it was
+    // first seen with, unique within the index
+    uint64_t id = 0;
+  };
+
+  explicit ItemIndex(std::filesystem::path path) : path(std::move(path)) {}
+
+  void load();
+  void save() const;
+
+  // Closest entry with the same footprint and quality, if its icon is similar
+  // enough.
+  const Entry *find(const ItemFingerprint &fingerprint) const;
+  // Identity of the item, registering it if it was never seen before.
+  uint64_t record(const ItemFingerprint &fingerprint);
+
+  // maximum number of differing hash bits for two icons to be the same item
+  int max_distance = 12;
+
+private:
+  static int footprint_key(int width, int height, int quality) {
+    return (quality * 16 + width) * 16 + height;
+  }
+  static int footprint_key(const ItemFingerprint &fingerprint) {
+    return footprint_key(fingerprint.width, fingerprint.height,
+                         fingerprint.quality);
+  }
+
+  std::filesystem::path path;
+  std::unordered_map<int, std::vector<Entry>> entries;
+  // every id handed out, so a hash collision gets a fresh id
+  std::unordered_set<uint64_t> ids;
+};
+} // namespace dfg
@@ -0,0 +1,170 @@
+#include "price_store.h"
+
+#include <cstring>
+#include <print>
+#include <vector>
+
+namespace dfg {
+static constexpr uint32_t price_store_magic = 0x53505744; // "DWPS"
+static constexpr uint32_t price_store_version = 2;
+static constexpr uint32_t initial_capacity = 1024;
+
+struct PriceStore::Header {
+  uint32_t magic;
+  uint32_t version;
+  // number of records the file has room for, the slot table is twice as big
+  uint32_t capacity;
+  uint32_t count;
+};
+
+struct PriceStore::Record {
+  uint64_t item_id;
+  int64_t observed_at;
+  int32_t price_system_buy;
+  int32_t price_market;
+  uint32_t can_sell_in_market;
+  int32_t quality;
+};
+
+size_t PriceStore::file_size_for(uint32_t capacity) {
+  return sizeof(Header) + sizeof(uint32_t) * capacity * 2 +
+         sizeof(Record) * size_t(capacity);
+}
+
+static uint64_t mix(uint64_t key) {
+  // splitmix64 finalizer, item ids are hash bits but may cluster
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ull;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebull;
+  key ^= key >> 31;
+  return key;
+}
+
+static int64_t now_seconds() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+PriceStore::Header *PriceStore::header() const {
+  return reinterpret_cast<Header *>(const_cast<char *>(file.data()));
+}
+uint32_t *PriceStore::slots() const {
+  return reinterpret_cast<uint32_t *>(header() + 1);
+}
+PriceStore::Record *PriceStore::records() const {
+  return reinterpret_cast<Record *>(slots() + header()->capacity * 2);
+}
+
+void PriceStore::map(const std::filesystem::path &at, uint32_t capacity) {
+  static_assert(sizeof(Header) == 16 && sizeof(Record) == 32);
+  std::filesystem::create_directories(at.parent_path());
+  file = MappedFile(at, MappedFile::Mode::ReadWrite, file_size_for(capacity));
+
+  auto h = header();
+  if (h->magic != price_store_magic || h->version != price_store_version ||
+      file.size() < file_size_for(h->capacity)) {
+    if (h->magic != 0) {
+      std::println("[price_store] {} is not a valid store, resetting",
+                   at.string());
+      std::memset(file.mutable_data(), 0, file.size());
+    }
+    h->magic = price_store_magic;
+    h->version = price_store_version;
+    h->capacity = capacity;
+    h->count = 0;
+  }
+}
+
+void PriceStore::open() {
+  map(path, initial_capacity);
+  std::println("[price_store] {} prices in {}", size(), path.string());
+}
+
+void PriceStore::flush() { file.flush(); }
+
+size_t PriceStore::size() const { return file.data() ? header()->count : 0; }
+
+uint32_t *PriceStore::find_slot(uint64_t item_id) const {
+  auto table = slots();
+  uint32_t mask = header()->capacity * 2 - 1;
+  for (uint32_t i = mix(item_id) & mask;; i = (i + 1) & mask) {
+    // slots store record index + 1, 0 is empty
+    if (table[i] == 0 || records()[table[i] - 1].item_id == item_id) {
+      return &table[i];
+    }
+  }
+}
+
+std::optional<PriceStore::Observation>
+PriceStore::lookup(uint64_t item_id, int quality) const {
+  if (!file.data()) {
+    return {};
+  }
+  auto slot = find_slot(item_id);
+  if (*slot == 0) {
+    return {};
+  }
+
+  const auto &r = records()[*slot - 1];
+  if (r.quality != quality) {
+    return {};
+  }
+  return Observation{r.price_system_buy, r.price_market,
+                     r.can_sell_in_market != 0, r.observed_at, r.quality};
+}
+
+void PriceStore::grow() {
+  std::vector<Record> existing(records(), records() + header()->count);
+  auto capacity = header()->capacity * 2;
+
+  // the larger table is built next to the store and only replaces it once
+  // complete, a crash midway leaves the old file as it was
+  auto grown = path;
+  grown += ".grow";
+  file.close();
+  std::filesystem::remove(grown);
+  map(grown, capacity);
+
+  for (const auto &r : existing) {
+    auto slot = find_slot(r.item_id);
+    records()[header()->count] = r;
+    *slot = ++header()->count;
+  }
+
+  file.flush();
+  file.close();
+  std::filesystem::rename(grown, path);
+  map(path, capacity);
+}
+
+void PriceStore::record(uint64_t item_id, const Observation &observation) {
+  if (!file.data()) {
+    open();
+  }
+
+  auto slot = find_slot(item_id);
+  if (*slot == 0) {
+    if (header()->count == header()->capacity) {
+      grow();
+      slot = find_slot(item_id);
+    }
+    records()[header()->count].item_id = item_id;
+    *slot = ++header()->count;
+  }
+
+  auto &r = records()[*slot - 1];
+  r.price_system_buy = observation.price_system_buy;
+  r.price_market = observation.price_market;
+  r.can_sell_in_market = observation.can_sell_in_market ? 1 : 0;
+  r.quality = observation.quality;
+  r.observed_at =
+      observation.observed_at ? observation.observed_at : now_seconds();
+}
+
+bool PriceStore::is_fresh(const Observation &observation,
+                          std::chrono::seconds max_age) const {
+  return now_seconds() - observation.observed_at <= max_age.count();
+}
+} // namespace dfg
@@ -0,0 +1,55 @@
+#pragma once
+#include "../utils/mapped_file.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+namespace dfg {
+// On-disk price memo keyed by item identity. The file is an open-addressing
+// hash table followed by an append-only record array, used in place through a
+// memory mapping: opening it parses nothing and lookups touch one or two pages.
+struct PriceStore {
+  struct Observation {
+    int price_system_buy = 0;
+    int price_market = 0;
+    bool can_sell_in_market = false;
+    // seconds since epoch
+    int64_t observed_at = 0;
+    // quality of the item the prices were read for
+    int quality = 0;
+  };
+
+  explicit PriceStore(std::filesystem::path path) : path(std::move(path)) {}
+
+  void open();
+  void flush();
+
+  // Only an observation made for the same quality is returned.
+  std::optional<Observation> lookup(uint64_t item_id, int quality) const;
+  // Replaces the observation for item_id, appending a record for new items.
+  void record(uint64_t item_id, const Observation &observation);
+  bool is_fresh(const Observation &observation,
+                std::chrono::seconds max_age) const;
+
+  size_t size() const;
+
+private:
+  struct Header;
+  struct Record;
+
+  static size_t file_size_for(uint32_t capacity);
+
+  Header *header() const;
+  uint32_t *slots() const;
+  Record *records() const;
+  // slot holding item_id, or the empty slot where it would be inserted
+  uint32_t *find_slot(uint64_t item_id) const;
+  void map(const std::filesystem::path &at, uint32_t capacity);
+  void grow();
+
+  std::filesystem::path path;
+  MappedFile file;
+};
+} // namespace dfg
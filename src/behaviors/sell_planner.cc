@@ -0,0 +1,138 @@
+#include "sell_planner.h"
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <print>
+#include <tuple>
+
+namespace dfg {
+int SellPlanner::clamp_top(int row) const {
+  return std::clamp(row, 0, std::max(max_top_row, 0));
+}
+
+SellPlanner::Cost SellPlanner::simulate(const std::vector<cv::Point> &cells,
+                                        const std::vector<Group> &groups,
+                                        int current_top_row) const {
+  Cost cost;
+  int top = current_top_row;
+  int direction = 0;
+  std::optional<cv::Point2d> mouse;
+  for (const auto &group : groups) {
+    if (group.top_row != top) {
+      int delta = group.top_row - top;
+      int new_direction = delta > 0 ? 1 : -1;
+      cost.scroll_rows += std::abs(delta);
+      if (direction != 0 && new_direction != direction) {
+        cost.direction_changes++;
+      }
+      direction = new_direction;
+      top = group.top_row;
+    }
+
+    for (auto index : group.items) {
+      cv::Point2d pos{(cells[index].x + 0.5) * cell_size.width,
+                      (cells[index].y - top + 0.5) * cell_size.height};
+      if (mouse) {
+        cost.travel += cv::norm(pos - *mouse);
+      }
+      mouse = pos;
+    }
+  }
+  return cost;
+}
+
+std::vector<SellPlanner::Group>
+SellPlanner::sweep(const std::vector<cv::Point> &cells, bool downwards) const {
+  std::vector<size_t> remaining(cells.size());
+  std::iota(remaining.begin(), remaining.end(), 0);
+  std::sort(remaining.begin(), remaining.end(), [&](size_t a, size_t b) {
+    return downwards ? cells[a].y < cells[b].y : cells[a].y > cells[b].y;
+  });
+
+  std::vector<Group> groups;
+  std::optional<cv::Point> mouse;
+  while (!remaining.empty()) {
+    // put the first item on the leading edge of the page
+    int first_row = cells[remaining.front()].y;
+    int top = clamp_top(downwards ? first_row : first_row - page_rows + 1);
+
+    std::vector<size_t> page, rest;
+    for (auto index : remaining) {
+      bool visible = cells[index].y >= top && cells[index].y < top + page_rows;
+      (visible ? page : rest).push_back(index);
+    }
+    if (page.empty()) {
+      // the row is out of scroll range, handle it where the list stops
+      page.push_back(rest.front());
+      rest.erase(rest.begin());
+    }
+
+    // nearest neighbour inside the page, starting where the mouse was
+    Group group{top, {}};
+    auto current =
+        mouse.value_or(cv::Point{cells[page.front()].x, cells[page.front()].y});
+    while (!page.empty()) {
+      auto nearest = std::min_element(page.begin(), page.end(),
+                                      [&](size_t a, size_t b) {
+                                        return cv::norm(cells[a] - current) <
+                                               cv::norm(cells[b] - current);
+                                      });
+      current = cells[*nearest];
+      group.items.push_back(*nearest);
+      page.erase(nearest);
+    }
+    mouse = current;
+
+    groups.push_back(std::move(group));
+    remaining = std::move(rest);
+  }
+  return groups;
+}
+
+SellPlanner::Plan SellPlanner::plan(const std::vector<cv::Point> &cells,
+                                    int current_top_row) const {
+  Plan plan;
+
+  // what handling the items in the given order costs, scrolling only when
+  // the next item is off-screen
+  std::vector<Group> naive;
+  int top = current_top_row;
+  for (size_t i = 0; i < cells.size(); ++i) {
+    if (cells[i].y < top || cells[i].y >= top + page_rows) {
+      top = clamp_top(cells[i].y);
+    }
+    if (naive.empty() || naive.back().top_row != top) {
+      naive.push_back({top, {}});
+    }
+    naive.back().items.push_back(i);
+  }
+  plan.naive_cost = simulate(cells, naive, current_top_row);
+
+  auto rank = [](const Cost &cost) {
+    return std::make_tuple(cost.scroll_rows, cost.direction_changes,
+                           cost.travel);
+  };
+
+  bool first = true;
+  for (bool downwards : {true, false}) {
+    auto groups = sweep(cells, downwards);
+    auto cost = simulate(cells, groups, current_top_row);
+    if (first || rank(cost) < rank(plan.cost)) {
+      plan.groups = std::move(groups);
+      plan.cost = cost;
+      first = false;
+    }
+  }
+
+  std::println("[planner] {} items: scroll {} rows ({} saved), {} direction "
+               "changes ({} saved), travel {:.0f} px ({:.0f} saved)",
+               cells.size(), plan.cost.scroll_rows,
+               plan.naive_cost.scroll_rows - plan.cost.scroll_rows,
+               plan.cost.direction_changes,
+               plan.naive_cost.direction_changes -
+                   plan.cost.direction_changes,
+               plan.cost.travel, plan.naive_cost.travel - plan.cost.travel);
+  return plan;
+}
+} // namespace dfg
@@ -0,0 +1,48 @@
+#pragma once
+#include "opencv2/opencv.hpp"
+
+#include <vector>
+
+namespace dfg {
+// Orders warehouse operations so the list scrolls in one direction as much as
+// possible and the mouse takes short hops within each page.
+struct SellPlanner {
+  // rows visible at once
+  int page_rows = 10;
+  // highest row the list can be scrolled to the top
+  int max_top_row = 0;
+  cv::Size cell_size;
+
+  struct Cost {
+    // wheel notches, one per row
+    int scroll_rows = 0;
+    int direction_changes = 0;
+    // mouse travel between consecutive items, in pixels
+    double travel = 0;
+  };
+
+  // Items handled with the list scrolled so top_row is the first visible row.
+  struct Group {
+    int top_row;
+    // indices into the planned cells
+    std::vector<size_t> items;
+  };
+
+  struct Plan {
+    std::vector<Group> groups;
+    Cost cost;
+    // the same items handled in the order given
+    Cost naive_cost;
+  };
+
+  // cells are the grid positions (column, row) of the items to handle.
+  Plan plan(const std::vector<cv::Point> &cells, int current_top_row) const;
+
+private:
+  int clamp_top(int row) const;
+  Cost simulate(const std::vector<cv::Point> &cells,
+                const std::vector<Group> &groups, int current_top_row) const;
+  std::vector<Group> sweep(const std::vector<cv::Point> &cells,
+                           bool downwards) const;
+};
+} // namespace dfg
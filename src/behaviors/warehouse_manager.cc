@@ -3,22 +3,68 @@
 #include "opencv2/highgui.hpp"
 
 namespace dfg {
+bool WarehouseManager::grid_still_valid(const FrameContext &frame) const {
+  if (!cached_grid || grid_samples.empty()) {
+    return false;
+  }
+  constexpr int tolerance = 12;
+  // sampled straight from the native pixels, gray() is never resampled;
+  // the samples are in develop coordinates like detection recorded them
+  const auto &gray = frame.native_gray();
+  auto native_rect = cv::Rect({}, gray.size());
+  size_t matching = 0;
+  for (const auto &[point, value] : grid_samples) {
+    auto native = frame.to_native(point);
+    if (native_rect.contains(native) &&
+        std::abs(gray.at<uint8_t>(native) - value) <= tolerance) {
+      matching++;
+    }
+  }
+  // a few samples may be covered by the cursor or a tooltip
+  return matching * 10 >= grid_samples.size() * 9;
+}
+
 WarehouseManager::GridDetectionResult
 WarehouseManager::detect_warehouse_grid() {
   using RelPos = App::RelPos;
-  auto left_top =
-      app.locate_image("warehouse/warehouse_lefttop.png", RelPos::TopRight);
-  auto right_top =
-      app.locate_image("warehouse/warehouse_righttop.png", RelPos::BottomLeft);
+  auto frame = app.capture_frame();
+  if (grid_still_valid(frame)) {
+    return *cached_grid;
+  }
+
+  auto left_top_rect =
+      app.locate_image_rect(frame, "warehouse/warehouse_lefttop.png");
+  auto right_top_rect =
+      app.locate_image_rect(frame, "warehouse/warehouse_righttop.png");
 
-  if (!left_top || !right_top) {
+  if (!left_top_rect || !right_top_rect) {
     throw std::runtime_error("Warehouse grid not found");
   }
 
-  auto wh_width = right_top->x - left_top->x;
+  auto left_top = app.rect_to_relpos(*left_top_rect, RelPos::TopRight);
+  auto right_top = app.rect_to_relpos(*right_top_rect, RelPos::BottomLeft);
+
+  auto wh_width = right_top.x - left_top.x;
   auto cell_width = (int)std::ceil(wh_width / 9.0f);
 
-  return {left_top->x, left_top->y, cell_width, cell_width};
+  // remember a lattice of pixels over both corner markers, later calls only
+  // compare these instead of searching the frame again
+  grid_samples.clear();
+  for (auto rect : {*left_top_rect, *right_top_rect}) {
+    for (int i = 1; i < 4; ++i) {
+      for (int j = 1; j < 4; ++j) {
+        cv::Point p{rect.x + rect.width * i / 4, rect.y + rect.height * j / 4};
+        grid_samples.emplace_back(
+            p, frame.native_gray().at<uint8_t>(frame.to_native(p)));
+      }
+    }
+  }
+
+  cached_grid =
+      GridDetectionResult{left_top.x, left_top.y, cell_width, cell_width};
+  std::println("[warehouse] grid detected at {},{} cell {}", left_top.x,
+               left_top.y, cell_width);
+  return *cached_grid;
 }
 cv::Mat WarehouseManager::GridDetectionResult::visualize(cv::Mat on) {
   int cols = 9;
@@ -36,6 +82,13 @@ cv::Mat WarehouseManager::GridDetectionResult::visualize(cv::Mat on) {
   return on;
 }
 
+static Task<std::vector<std::optional<OCRResult>>>
+read_prices(App &app, cv::Mat system_price, cv::Mat market_price) {
+  co_await schedule_on(app.runtime.pool, Priority::Background, "ocr");
+  co_return app.ocr.recognize_batch_eng({system_price, market_price},
+                                        ocr_profiles::price);
+}
+
 struct EscapePresser {
   App &app;
   bool pressed = false;
@@ -57,6 +110,22 @@ struct EscapePresser {
 static constexpr int max_sell_quality = 4;
 static constexpr int min_delta_price_to_sell_on_market = 6000;
 static constexpr int max_down_price = 7;
+// rows of the grid visible at once
+static constexpr int warehouse_page_rows = 10;
+
+static uint64_t roi_checksum(const cv::Mat &img) {
+  // FNV-1a over the pixel bytes
+  uint64_t hash = 14695981039346656037ull;
+  size_t row_bytes = img.cols * img.elemSize();
+  for (int y = 0; y < img.rows; ++y) {
+    auto row = img.ptr<uint8_t>(y);
+    for (size_t i = 0; i < row_bytes; ++i) {
+      hash ^= row[i];
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
 
 int color_similarity_lab(const cv::Vec3b &a, const cv::Vec3b &b) {
   cv::Mat lab_a, lab_b;
@@ -68,6 +137,14 @@ int color_similarity_lab(const cv::Vec3b &a, const cv::Vec3b &b) {
 std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
   app.focus_df();
   std::vector<ItemInfo> items;
+  // probed items whose prices are still being recognized
+  struct PendingPrices {
+    ItemInfo item;
+    ItemFingerprint fingerprint;
+    std::optional<bool> can_sell_in_market;
+    Task<std::vector<std::optional<OCRResult>>> texts;
+  };
+  std::vector<PendingPrices> pending_prices;
   auto grid_info = detect_warehouse_grid();
   std::vector<std::vector<bool>> grid(100, std::vector<bool>(9, false));
 
@@ -90,18 +167,16 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
   int current_y_grid = 1, warehouse_size = 0;
   bool in_batch_sell_mode = false;
   auto recognize_current_scrollbar = [&]() {
-    auto cap = app.capture_dfwin();
+    auto cap = app.capture_frame();
     constexpr int scrollarea_height_normal = 848;
     constexpr int scrollarea_height_batchsellmode = 803;
     int scrollarea_height = in_batch_sell_mode ? scrollarea_height_batchsellmode
                                                : scrollarea_height_normal;
 
-    auto analyze_scrollbar = [&](const cv::Mat &img) {
-      auto scrollbar_area =
-          img(cv::Rect{grid_info.start_x + 9 * grid_info.cell_width, 130, 25,
-                       scrollarea_height});
-      auto gray_scrollbar_area = cv::Mat();
-      cv::cvtColor(scrollbar_area, gray_scrollbar_area, cv::COLOR_BGR2GRAY);
+    auto analyze_scrollbar = [&](const FrameContext &frame) {
+      auto gray_scrollbar_area =
+          frame.gray(cv::Rect{grid_info.start_x + 9 * grid_info.cell_width,
+                              130, 25, scrollarea_height});
       auto gray_binary_max_scrollbar_area = cv::Mat();
       cv::threshold(gray_scrollbar_area, gray_binary_max_scrollbar_area, 95,
                     130, cv::THRESH_BINARY);
@@ -125,14 +200,14 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
 
     static std::optional<float> sb_scale_normal, sb_scale_batchsellmode;
     auto analyze_scroll_scale = [&]() {
-      auto cap1 = app.capture_dfwin();
+      auto cap1 = app.capture_frame();
       auto [y1, h1] = analyze_scrollbar(cap1);
       app.move_to_abs(pointInGrid);
       for (int i = 0; i < 5; ++i) {
         app.input_simulator.wheel_scroll(y1 < 100 ? -WHEEL_DELTA : WHEEL_DELTA);
         app.sleep(100);
       }
-      auto cap2 = app.capture_dfwin();
+      auto cap2 = app.capture_frame();
       auto [y2, h2] = analyze_scrollbar(cap2);
       for (int i = 0; i < 5; ++i) {
         app.input_simulator.wheel_scroll(y1 > 100 ? -WHEEL_DELTA : WHEEL_DELTA);
@@ -198,23 +273,207 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
 
   auto reach_grid = [&](int x, int y) {
     recognize_current_scrollbar();
-    constexpr static int max_cell_rows = 10;
-    if (y >= current_y_grid + max_cell_rows || y < current_y_grid) {
+    if (y >= current_y_grid + warehouse_page_rows || y < current_y_grid) {
       scroll_to_y(y);
     }
 
     return grid_center(x, y);
   };
+  // scroll through the warehouse a page at a time and grab only the grid, all
+  // cell analysis then runs in parallel on the stitched result
+  auto capture_mosaic = [&](int rows) {
+    constexpr int page_rows = warehouse_page_rows;
+    WarehouseMosaic mosaic(app.runtime.pool, rows, grid_info.cell_width,
+                           grid_info.cell_height);
+    int empty_pages = 0;
+    for (int top = 0; top < rows; top += page_rows) {
+      int page_top = std::min(top, std::max(0, rows - page_rows));
+      scroll_to_y(page_top);
+      app.move_to_abs(pointOutOfGrid);
+      app.sleep(60);
+      auto frame = app.capture_frame();
+      auto region =
+          cv::Rect(grid_info.start_x, grid_info.start_y,
+                   WarehouseMosaic::cols * grid_info.cell_width,
+                   page_rows * grid_info.cell_height) &
+          cv::Rect({}, frame.size());
+      mosaic.add_page(frame.bgra(region), page_top);
+      mosaic.analyze_rows(page_top, page_rows);
+
+      // the rest of the warehouse is most likely empty as well
+      empty_pages =
+          mosaic.rows_empty(page_top, page_rows) ? empty_pages + 1 : 0;
+      if (empty_pages >= empty_pages_to_stop) {
+        std::println("[warehouse] page at row {} is empty, stop capturing",
+                     page_top);
+        break;
+      }
+    }
+    return mosaic;
+  };
+
+  // without a previous scan nothing can be reused, and the mosaic would only
+  // cost an extra pass
+  std::optional<WarehouseMosaic> mosaic;
+  if (mosaic_scan && snapshot.has_cells()) {
+    // also measures warehouse_size
+    scroll_to_y(0);
+    if (warehouse_size - 14 > 0) {
+      mosaic = capture_mosaic(warehouse_size - 14);
+    }
+  }
+
+  auto next_snapshot = snapshot.next();
+  if (mosaic) {
+    for (int y = 0; y < mosaic->rows(); y++) {
+      for (int x = 0; x < WarehouseMosaic::cols; x++) {
+        if (mosaic->cell(x, y).captured) {
+          next_snapshot.record_cell(x, y, mosaic->cell(x, y).hash);
+        }
+      }
+    }
+  }
+
+  // hash of cell (x, y) as it looks now, from the mosaic or the given frame
+  auto current_cell_hash =
+      [&](int x, int y,
+          const FrameContext *frame) -> std::optional<uint64_t> {
+    if (mosaic && y < mosaic->rows() && mosaic->cell(x, y).captured) {
+      return mosaic->cell(x, y).hash;
+    }
+    if (!frame) {
+      return {};
+    }
+    auto rect = grid_rect(x, y);
+    if ((rect & cv::Rect({}, frame->size())) != rect) {
+      return {};
+    }
+    return WarehouseSnapshot::cell_hash(frame->gray(rect));
+  };
+
+  // the item the last scan found at (x, y), if none of its cells changed
+  auto remembered_item =
+      [&](int x, int y,
+          const FrameContext *frame) -> const WarehouseSnapshot::Item * {
+    auto item = snapshot.item_at(x, y);
+    if (!item) {
+      return nullptr;
+    }
+    for (int i = item->x; i < item->x + item->width; ++i) {
+      for (int j = item->y; j < item->y + item->height; ++j) {
+        auto previous = snapshot.cell(i, j);
+        auto current = current_cell_hash(i, j, frame);
+        if (!previous || !current ||
+            !WarehouseSnapshot::same_cell(*previous, *current)) {
+          return nullptr;
+        }
+      }
+    }
+    return item;
+  };
+
+  // Settles an item from what is already known about it: its quality rules it
+  // out, or the price store has fresh prices for it. Returns false if the
+  // sell dialog still has to be probed.
+  auto classify_without_probe = [&](int left, int top, int width, int height,
+                                    int quality,
+                                    const ItemFingerprint &fingerprint) {
+    next_snapshot.record_item({left, top, width, height, quality});
+
+    if (quality > max_sell_quality) {
+      return true;
+    }
+
+    auto known = item_index.find(fingerprint);
+    auto cached_price =
+        known ? price_store.lookup(known->id, quality) : std::nullopt;
+    if (!cached_price || !price_store.is_fresh(*cached_price, price_max_age)) {
+      return false;
+    }
+
+    ItemInfo item;
+    item.x = left;
+    item.y = top;
+    item.width = width;
+    item.height = height;
+    item.quality = quality;
+    item.price_system_buy = cached_price->price_system_buy;
+    item.price_market = cached_price->price_market;
+    item.can_sell_in_market = cached_price->can_sell_in_market;
+
+    std::println("[warehouse] item known: {}", item);
+    items.push_back(item);
+    return true;
+  };
+
+  // stop once enough whole pages past the last item are empty, so the scan
+  // costs what the warehouse holds rather than what it could hold
+  int last_occupied_row = -1;
+
   scroll_to_y(0);
   for (int y = 0; y < warehouse_size - 14; y++) {
+    if (y - last_occupied_row > warehouse_page_rows * empty_pages_to_stop) {
+      std::println("[warehouse] rows {}-{} are empty, stop scanning",
+                   last_occupied_row + 1, y - 1);
+      break;
+    }
+
+    // rows the mosaic fully explains never need the UI
+    if (mosaic && y < mosaic->rows() && mosaic->cell(0, y).captured) {
+      bool needs_ui = false;
+      for (int x = 0; x < WarehouseMosaic::cols; x++) {
+        if (grid[y][x] || !mosaic->cell(x, y).empty) {
+          last_occupied_row = y;
+        }
+        if (grid[y][x] || mosaic->cell(x, y).empty) {
+          continue;
+        }
+        auto remembered = remembered_item(x, y, nullptr);
+        if (!remembered) {
+          needs_ui = true;
+          continue;
+        }
+
+        auto fingerprint = ItemFingerprint::of(
+            mosaic->region(remembered->x, remembered->y, remembered->width,
+                           remembered->height),
+            remembered->width, remembered->height, remembered->quality);
+        if (!classify_without_probe(remembered->x, remembered->y,
+                                    remembered->width, remembered->height,
+                                    remembered->quality, fingerprint)) {
+          needs_ui = true;
+          continue;
+        }
+
+        for (int i = remembered->x; i < remembered->x + remembered->width;
+             ++i) {
+          for (int j = remembered->y; j < remembered->y + remembered->height;
+               ++j) {
+            grid[j][i] = true;
+          }
+        }
+      }
+
+      if (!needs_ui) {
+        std::println("[warehouse] row {} resolved from mosaic", y);
+        continue;
+      }
+    }
+
     scroll_to_y(y < 2 ? y : y - 1);
     app.sleep(100);
 
     app.move_to_abs(pointOutOfGrid);
     app.sleep(60);
-    auto img_no_highlight = app.capture_dfwin();
+    auto img_no_highlight = app.capture_frame();
+    for (int x = 0; x < 9; x++) {
+      next_snapshot.record_cell(x, y,
+                                WarehouseSnapshot::cell_hash(
+                                    img_no_highlight.gray(grid_rect(x, y))));
+    }
     for (int x = 0; x < 9; x++) {
       if (grid[y][x]) {
+        last_occupied_row = y;
         continue;
       }
 
@@ -222,52 +481,80 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
 
       // do a canny to determine if it's an empty slot fast
       auto rect = grid_rect(x, y);
-      auto slot = img_no_highlight(rect);
-      cv::Mat gray_slot;
-      cv::cvtColor(slot, gray_slot, cv::COLOR_BGR2GRAY);
       cv::Mat edges;
-      cv::Canny(gray_slot, edges, 50, 150);
+      cv::Canny(img_no_highlight.gray(rect), edges, 50, 150);
 
       if (cv::countNonZero(edges) < 7) {
         std::println("[warehouse] slot {} {} is empty", x, y);
         continue;
       }
+      last_occupied_row = y;
 
-      app.move_to_abs(reach_grid(x, y));
-      app.sleep(30);
-
-      auto img_highlight = app.capture_dfwin();
-      // check the slots of the item
-      cv::Mat diff;
-      cv::absdiff(img_no_highlight, img_highlight, diff);
-      cv::cvtColor(diff, diff, cv::COLOR_BGR2GRAY);
-      cv::threshold(diff, diff, 5, 30, cv::THRESH_BINARY);
-      // cv::imshow("diff", diff);
-      // cv::waitKey(0);
-      std::vector<std::pair<int, int>> slots_thisitem;
-      for (int x_slot = 0; x_slot < 6; ++x_slot) {
-        for (int y_slot = 0; y_slot < 6; ++y_slot) {
-          auto rect = grid_rect(x_slot + x, y_slot + y);
-          try {
-            auto slot = diff(rect);
-            if (cv::countNonZero(slot) > 500) {
+      int left = 1000, right = -1, top = 1000, bottom = -1;
+      uint8_t quality = 0;
+      bool hovering = false;
+      if (auto remembered = remembered_item(x, y, &img_no_highlight)) {
+        // unchanged since the last scan, no need to hover it
+        left = remembered->x;
+        top = remembered->y;
+        right = remembered->x + remembered->width - 1;
+        bottom = remembered->y + remembered->height - 1;
+        quality = remembered->quality;
+        std::println("[warehouse] slot {} {} unchanged since last scan", x, y);
+      } else {
+        auto hovered = app.move_to_abs(reach_grid(x, y));
+        hovering = true;
+
+        // the highlight of the hovered cell acknowledges the move; wait
+        // until the cell changes as much as the slot check below needs, so
+        // the cursor or the first frame of the fade does not end the wait
+        constexpr int min_highlight_pixels = 500;
+        auto img_highlight =
+            app.wait_for_change(hovered, img_no_highlight, grid_rect(x, y),
+                                min_highlight_pixels, 500);
+        if (!img_highlight) {
+          // no visible highlight yet, go on with the newest frame rather
+          // than dropping the item from the scan
+          std::println("[warehouse] slot {} {} showed no hover highlight", x,
+                       y);
+          img_highlight = app.capture_frame_after(hovered);
+        }
+        // check the slots of the item, an item spans at most 6x6 cells
+        auto item_area = (grid_rect(x, y) | grid_rect(x + 5, y + 5)) &
+                         cv::Rect({}, img_no_highlight.size());
+        cv::Mat diff;
+        cv::absdiff(img_no_highlight.gray(item_area),
+                    img_highlight->gray(item_area), diff);
+        cv::threshold(diff, diff, 5, 30, cv::THRESH_BINARY);
+        // cv::imshow("diff", diff);
+        // cv::waitKey(0);
+        std::vector<std::pair<int, int>> slots_thisitem;
+        for (int x_slot = 0; x_slot < 6; ++x_slot) {
+          for (int y_slot = 0; y_slot < 6; ++y_slot) {
+            auto rect = grid_rect(x_slot + x, y_slot + y);
+            if ((rect & item_area) != rect) {
+              continue;
+            }
+            auto slot = diff(rect - item_area.tl());
+            if (cv::countNonZero(slot) > min_highlight_pixels) {
               slots_thisitem.emplace_back(x_slot + x, y_slot + y);
             }
-          } catch (const std::exception &e) {
           }
         }
-      }
 
-      if (slots_thisitem.empty()) {
-        continue;
-      }
+        if (slots_thisitem.empty()) {
+          std::println("[warehouse] slot {} {} has no highlighted cells, "
+                       "item skipped",
+                       x, y);
+          continue;
+        }
 
-      int left = 1000, right = -1, top = 1000, bottom = -1;
-      for (const auto &slot : slots_thisitem) {
-        left = std::min(left, slot.first);
-        right = std::max(right, slot.first);
-        top = std::min(top, slot.second);
-        bottom = std::max(bottom, slot.second);
+        for (const auto &slot : slots_thisitem) {
+          left = std::min(left, slot.first);
+          right = std::max(right, slot.first);
+          top = std::min(top, slot.second);
+          bottom = std::max(bottom, slot.second);
+        }
       }
 
       for (int i = left; i <= right; ++i) {
@@ -285,7 +572,7 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
       std::println("[warehouse] item pos {},{} grid: {}x{}", left, top,
                    right - left + 1, bottom - top + 1);
 
-      auto item_img = img_no_highlight(item_rect);
+      auto item_img = img_no_highlight.bgra(item_rect);
       // cv::imshow("item", item_img);
       // cv::waitKey(0);
       // determine quality by color
@@ -293,49 +580,63 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
           {0x1a1f22, 1}, {0x1a2824, 2}, {0x22313d, 3},
           {0x262634, 4}, {0x352b24, 5}, {0x3c2224, 6}};
 
-      uint8_t quality = 0;
-      int mindiff = 0xffff;
-      auto color = item_img.at<cv::Vec4b>(item_img.rows / 2, item_img.cols - 3);
-      int r1 = color[2];
-      int g1 = color[1];
-      int b1 = color[0];
+      if (quality == 0) {
+        int mindiff = 0xffff;
+        auto color =
+            item_img.at<cv::Vec4b>(item_img.rows / 2, item_img.cols - 3);
+        int r1 = color[2];
+        int g1 = color[1];
+        int b1 = color[0];
 
-      // item_img.at<cv::Vec4b>(3, item_img.cols - 3) = cv::Vec4b{0, 0, 255,
-      // 255}; cv::imshow("item color", item_img); cv::waitKey(0);
+        // item_img.at<cv::Vec4b>(3, item_img.cols - 3) = cv::Vec4b{0, 0, 255,
+        // 255}; cv::imshow("item color", item_img); cv::waitKey(0);
 
-      std::println("[warehouse] item color: #{:02x}{:02x}{:02x}", r1, g1, b1);
+        std::println("[warehouse] item color: #{:02x}{:02x}{:02x}", r1, g1,
+                     b1);
 
-      for (const auto &pair : color_quality_map) {
-        int r2 = (pair.first >> 16) & 0xFF;
-        int g2 = (pair.first >> 8) & 0xFF;
-        int b2 = pair.first & 0xFF;
+        for (const auto &pair : color_quality_map) {
+          int r2 = (pair.first >> 16) & 0xFF;
+          int g2 = (pair.first >> 8) & 0xFF;
+          int b2 = pair.first & 0xFF;
 
-        int diff = color_similarity_lab(
-            cv::Vec3b{(uint8_t)b1, (uint8_t)g1, (uint8_t)r1},
-            cv::Vec3b{(uint8_t)b2, (uint8_t)g2, (uint8_t)r2});
+          int diff = color_similarity_lab(
+              cv::Vec3b{(uint8_t)b1, (uint8_t)g1, (uint8_t)r1},
+              cv::Vec3b{(uint8_t)b2, (uint8_t)g2, (uint8_t)r2});
 
-        if (diff < mindiff) {
-          quality = pair.second;
-          mindiff = diff;
+          if (diff < mindiff) {
+            quality = pair.second;
+            mindiff = diff;
+          }
         }
       }
 
-      if (quality > max_sell_quality) {
+      // items seen in an earlier run are classified from their icon alone
+      auto fingerprint = ItemFingerprint::of(item_img, right - left + 1,
+                                             bottom - top + 1, quality);
+      if (classify_without_probe(left, top, right - left + 1,
+                                 bottom - top + 1, quality, fingerprint)) {
         continue;
       }
 
-      app.input_simulator.left_click();
-      app.sleep(100);
+      if (!hovering) {
+        app.move_to_abs(grid_center(left, top));
+        app.sleep(30);
+      }
+      auto clicked = app.input_simulator.left_click();
 
       EscapePresser escape_presser(app);
-      auto btn_sell = app.wait_for_image("warehouse/btn_sell.png");
+      auto btn_sell = sync_wait(item_popup.open(1000, clicked));
       if (btn_sell) {
-        app.move_to_abs(btn_sell.value());
-        app.input_simulator.left_click();
+        app.move_to_abs(app.rect_to_relpos(*btn_sell, App::RelPos::Center));
+        auto sell_clicked = app.input_simulator.left_click();
         auto system_price_line =
-            app.wait_for_image_rect("warehouse/sell_ui/text_system_price.png");
-        auto market_price_line =
-            app.wait_for_image_rect("warehouse/sell_ui/text_market_price.png");
+            sync_wait(sell_dialog.open(1000, sell_clicked));
+        auto screenshot = app.capture_frame();
+        auto market_price_line = sell_dialog.locate(
+            "warehouse/sell_ui/text_market_price.png", screenshot);
+        if (!system_price_line || !market_price_line) {
+          continue;
+        }
 
         // screenshot from the price line to the end of the line
         auto system_price_rect =
@@ -345,64 +646,77 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
             cv::Rect(market_price_line->x + market_price_line->width,
                      market_price_line->y, 400, market_price_line->height);
 
-        auto screenshot = app.capture_dfwin();
-        auto system_price_img = screenshot(system_price_rect);
-        auto market_price_img = screenshot(market_price_rect);
-
-        auto system_price_text = app.ocr.recognize_text_eng(system_price_img);
-        auto market_price_text = app.ocr.recognize_text_eng(market_price_img);
-
-        if (system_price_text && market_price_text) {
-          ItemInfo item;
-          item.x = left;
-          item.y = top;
-          item.width = right - left + 1;
-          item.height = bottom - top + 1;
-
-          // parse the price
-          try {
-            auto extractNumber = [](const std::string &text) {
-              std::string num_str;
-              for (char c : text) {
-                if (isdigit(c)) {
-                  num_str += c;
-                }
-              }
-              return std::stoi(num_str);
-            };
+        ItemInfo item;
+        item.x = left;
+        item.y = top;
+        item.width = right - left + 1;
+        item.height = bottom - top + 1;
+        item.quality = quality;
+
+        std::optional<bool> can_sell_in_market;
+        if (auto btn_sell_market = sell_dialog.locate(
+                "warehouse/sell_ui/btn_sell_market.png", screenshot, 0.1f)) {
+          // if the button is green, it can be sold in market
+          // else it is gray, it cannot
+          cv::Scalar avg_color =
+              cv::mean(screenshot.bgra(*btn_sell_market));
+          std::println("[warehouse] avg color: {} {} {}", avg_color[0],
+                       avg_color[1], avg_color[2]);
+          can_sell_in_market = std::abs(avg_color[0] - avg_color[1]) < 3;
+        }
 
-            item.price_system_buy = extractNumber(system_price_text.value());
-            item.price_market = extractNumber(market_price_text.value());
+        escape_presser.press();
 
-            auto rect_sell_in_market = screenshot(
-                app.locate_image_rect("warehouse/sell_ui/btn_sell_market.png")
-                    .value());
+        // the prices are recognized on the vision pool while the scan moves
+        // on to the next item
+        auto prices =
+            read_prices(app, screenshot.bgra(system_price_rect).clone(),
+                        screenshot.bgra(market_price_rect).clone());
+        prices.start();
+        pending_prices.push_back(
+            {item, fingerprint, can_sell_in_market, std::move(prices)});
+      }
 
-            // if the button is green, it can be sold in market
-            // else it is gray, it cannot
-            cv::Scalar avg_color = cv::mean(rect_sell_in_market);
-            std::println("[warehouse] avg color: {} {} {}", avg_color[0],
-                         avg_color[1], avg_color[2]);
-            item.can_sell_in_market = std::abs(avg_color[0] - avg_color[1]) < 3;
+      app.sleep(100);
+    }
+  }
 
-            escape_presser.press();
+  for (auto &pending : pending_prices) {
+    auto price_texts = sync_wait(pending.texts);
+    auto &system_price_text = price_texts[0];
+    auto &market_price_text = price_texts[1];
+    if (!system_price_text || !market_price_text) {
+      continue;
+    }
 
-            item.quality = quality;
-          } catch (const std::exception &e) {
-            item.price_system_buy = 0;
-            item.price_market = 0;
-            item.can_sell_in_market = false;
-          }
+    auto item = pending.item;
+    auto price_system_buy = OCR::parse_int(system_price_text->text);
+    auto price_market = OCR::parse_int(market_price_text->text);
+    if (price_system_buy && price_market && pending.can_sell_in_market) {
+      item.price_system_buy = *price_system_buy;
+      item.price_market = *price_market;
+      item.can_sell_in_market = *pending.can_sell_in_market;
+      price_store.record(item_index.record(pending.fingerprint),
+                         {item.price_system_buy, item.price_market,
+                          item.can_sell_in_market, 0, item.quality});
+    } else {
+      item.price_system_buy = 0;
+      item.price_market = 0;
+      item.can_sell_in_market = false;
+    }
 
-          std::println("[warehouse] item found: {}", item);
+    std::println("[warehouse] item found: {}", item);
+    items.push_back(item);
+  }
 
-          items.push_back(item);
-        }
-      }
+  item_index.save();
+  price_store.flush();
+  snapshot = std::move(next_snapshot);
+  snapshot.save();
 
-      app.sleep(100);
-    }
-  }
+  auto ocr_stats = app.ocr.cache_stats();
+  std::println("[warehouse] ocr cache hits: {}, misses: {}, retries: {}",
+               ocr_stats.hits, ocr_stats.misses, ocr_stats.retries);
 
   std::vector<ItemInfo> items_to_sell_in_market;
   std::vector<ItemInfo> items_to_sell_system;
@@ -418,6 +732,22 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
     }
   }
 
+  // order the operations page by page, so the list is swept instead of
+  // bouncing up and down
+  auto plan_order = [&](const std::vector<ItemInfo> &to_plan) {
+    SellPlanner planner;
+    planner.page_rows = warehouse_page_rows;
+    // the scan never scrolls further than this either
+    planner.max_top_row = warehouse_size - 16;
+    planner.cell_size = {grid_info.cell_width, grid_info.cell_height};
+
+    std::vector<cv::Point> cells;
+    for (const auto &item : to_plan) {
+      cells.emplace_back(item.x, item.y);
+    }
+    return planner.plan(cells, current_y_grid);
+  };
+
   // batch sell items to be sold to system
   if (items_to_sell_system.size() > 1) {
     in_batch_sell_mode = true;
@@ -425,11 +755,101 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
     app.input_simulator.left_click();
     app.sleep(100);
 
-    for (const auto &item : items_to_sell_system) {
-      app.move_to_abs(reach_grid(item.x, item.y));
-      app.sleep(50);
-      app.input_simulator.left_click();
-      app.sleep(80);
+    // Click every item of a page back to back, then check all of them on one
+    // capture and click again only the ones that still look unselected.
+    auto select_page = [&](const std::vector<ItemInfo> &page_items) {
+      app.move_to_abs(pointOutOfGrid);
+      app.sleep(60);
+      auto before = app.capture_frame();
+
+      std::vector<const ItemInfo *> targets;
+      for (const auto &item : page_items) {
+        targets.push_back(&item);
+      }
+
+      // one diff and one integral image over the cells, then O(1) per cell
+      auto changed_pixels = [&](const FrameContext &after,
+                                const std::vector<const ItemInfo *> &cells) {
+        auto frame_rect = cv::Rect({}, before.size());
+        cv::Rect area;
+        for (auto item : cells) {
+          area |= grid_rect(item->x, item->y) & frame_rect;
+        }
+        std::vector<int> counts(cells.size());
+        if (area.empty()) {
+          return counts;
+        }
+        cv::Mat diff, changed;
+        cv::absdiff(before.gray(area), after.gray(area), diff);
+        cv::threshold(diff, diff, 5, 1, cv::THRESH_BINARY);
+        cv::integral(diff, changed, CV_32S);
+
+        for (size_t i = 0; i < cells.size(); ++i) {
+          auto rect = grid_rect(cells[i]->x, cells[i]->y) & frame_rect;
+          if (rect.empty()) {
+            continue;
+          }
+          rect -= area.tl();
+          counts[i] = changed.at<int>(rect.br()) -
+                      changed.at<int>(rect.y + rect.height, rect.x) -
+                      changed.at<int>(rect.y, rect.x + rect.width) +
+                      changed.at<int>(rect.tl());
+        }
+        return counts;
+      };
+
+      constexpr int max_select_attempts = 3;
+      constexpr int min_selected_pixels = 200;
+      // a cell this close to its unselected look is certainly not selected
+      constexpr int max_unselected_pixels = 20;
+      for (int attempt = 0; attempt < max_select_attempts && !targets.empty();
+           ++attempt) {
+        for (auto item : targets) {
+          app.move_to_abs(grid_center(item->x, item->y), 15);
+          app.input_simulator.left_click();
+          app.sleep(15, 0);
+        }
+        app.move_to_abs(pointOutOfGrid);
+        app.sleep(100);
+
+        auto counts = changed_pixels(app.capture_frame(), targets);
+        std::vector<const ItemInfo *> missed;
+        for (size_t i = 0; i < targets.size(); ++i) {
+          if (counts[i] < min_selected_pixels) {
+            missed.push_back(targets[i]);
+          }
+        }
+        std::println("[warehouse] batch select: {} of {} missed", missed.size(),
+                     targets.size());
+        if (missed.empty() || attempt + 1 == max_select_attempts) {
+          break;
+        }
+
+        // A click toggles, so a missed cell is only clicked again once a
+        // later frame still shows it unselected. A slow highlight or a weak
+        // diff would otherwise deselect an item that was selected.
+        app.sleep(100);
+        counts = changed_pixels(app.capture_frame(false), missed);
+        targets.clear();
+        for (size_t i = 0; i < missed.size(); ++i) {
+          if (counts[i] <= max_unselected_pixels) {
+            targets.push_back(missed[i]);
+          } else if (counts[i] < min_selected_pixels) {
+            std::println("[warehouse] batch select: {},{} is unclear, not "
+                         "clicked again",
+                         missed[i]->x, missed[i]->y);
+          }
+        }
+      }
+    };
+
+    for (const auto &group : plan_order(items_to_sell_system).groups) {
+      scroll_to_y(group.top_row);
+      std::vector<ItemInfo> page_items;
+      for (auto index : group.items) {
+        page_items.push_back(items_to_sell_system[index]);
+      }
+      select_page(page_items);
     }
     app.sleep(300);
     app.move_to_abs(
@@ -454,16 +874,17 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
     app.input_simulator.left_click();
     app.sleep(100);
 
-    auto btn_sell = app.wait_for_image("warehouse/btn_sell.png");
+    auto btn_sell = sync_wait(item_popup.open());
     if (btn_sell) {
-      app.move_to_abs(btn_sell.value());
+      app.move_to_abs(app.rect_to_relpos(*btn_sell, App::RelPos::Center));
       app.input_simulator.left_click();
       app.sleep(100);
 
-      auto btn_sell_system =
-          app.wait_for_image("warehouse/sell_ui/btn_sell_system.png");
+      auto btn_sell_system = sync_wait(
+          sell_dialog.open_for("warehouse/sell_ui/btn_sell_system.png"));
       if (btn_sell_system) {
-        app.move_to_abs(btn_sell_system.value());
+        app.move_to_abs(
+            app.rect_to_relpos(*btn_sell_system, App::RelPos::Center));
         app.sleep(500);
         app.input_simulator.left_click();
       }
@@ -472,71 +893,128 @@ std::vector<WarehouseManager::ItemInfo> WarehouseManager::get_items() {
 
   app.sleep(500);
 
-  // sell items to market one by one
-  for (const auto &item : items_to_sell_in_market) {
-    app.move_to_abs(reach_grid(item.x, item.y));
-    app.input_simulator.left_click();
-    app.sleep(100);
-
-    auto btn_sell = app.wait_for_image("warehouse/btn_sell.png");
-    if (btn_sell) {
-      app.move_to_abs(btn_sell.value());
+  // sell items to market one by one, page by page in the planned order
+  for (const auto &group : plan_order(items_to_sell_in_market).groups) {
+    for (auto index : group.items) {
+      const auto &item = items_to_sell_in_market[index];
+      // a no-op unless a dialog moved the list since the last item
+      scroll_to_y(group.top_row);
+      app.move_to_abs(grid_center(item.x, item.y));
       app.input_simulator.left_click();
       app.sleep(100);
 
-      auto btn_sell_market =
-          app.wait_for_image("warehouse/sell_ui/btn_sell_market.png");
-      if (btn_sell_market) {
-        app.move_to_abs(btn_sell_market.value());
-        app.sleep(400);
+      auto btn_sell = sync_wait(item_popup.open());
+      if (btn_sell) {
+        app.move_to_abs(app.rect_to_relpos(*btn_sell, App::RelPos::Center));
         app.input_simulator.left_click();
         app.sleep(100);
-        app.move_to_abs(100, 100);
-        app.sleep(200);
 
-        auto btn_minus =
-            app.wait_for_image("warehouse/btn_sell_market_minus_price.png");
-        if (btn_minus) {
-          app.move_to_abs(btn_minus.value());
+        auto btn_sell_market = sync_wait(
+            sell_dialog.open_for("warehouse/sell_ui/btn_sell_market.png"));
+        if (btn_sell_market) {
+          app.move_to_abs(
+              app.rect_to_relpos(*btn_sell_market, App::RelPos::Center));
+          app.sleep(400);
+          app.input_simulator.left_click();
           app.sleep(100);
-          auto start = app.capture_dfwin();
-          int iDownPrice = 0;
-          while (true) {
-            if (iDownPrice++ > max_down_price) {
-              break;
+          app.move_to_abs(100, 100);
+          app.sleep(200);
+
+          auto btn_minus = sync_wait(market_dialog.open());
+          if (btn_minus) {
+            app.move_to_abs(
+                app.rect_to_relpos(*btn_minus, App::RelPos::Center));
+            app.sleep(100);
+
+            // Watch the band of the price row next to the price-down button,
+            // anchored on the button itself. Only if no click changed it is
+            // the whole lower-left part of the window, where the tier widget
+            // lives, compared once, so a redraw outside the band is not
+            // mistaken for a stuck tier.
+            auto window_rect =
+                cv::Rect(0, 0, App::develop_df_width, App::develop_df_height);
+            auto wide_roi = cv::Rect(0, App::develop_df_height * 0.35,
+                                     App::develop_df_width * 0.57,
+                                     App::develop_df_height * 0.65 - 1);
+            auto band_roi = cv::Rect(0, btn_minus->y - btn_minus->height * 2,
+                                     wide_roi.width, btn_minus->height * 5) &
+                            window_rect;
+            auto band_start = app.capture_dfwin_roi(band_roi);
+            auto wide_start = app.capture_dfwin_roi(wide_roi);
+            auto band_checksum = roi_checksum(band_start);
+            // the captures are at native resolution, so is the pixel count
+            auto scale = app.window_geometry.scale();
+            auto min_changed_pixels =
+                static_cast<int>(600 / (scale * scale));
+            auto changed = [&](const cv::Mat &start, const cv::Mat &end) {
+              cv::Mat diff;
+              cv::absdiff(start, end, diff);
+              cv::cvtColor(diff, diff, cv::COLOR_BGRA2GRAY);
+              cv::threshold(diff, diff, 5, 30, cv::THRESH_BINARY);
+              return cv::countNonZero(diff) > min_changed_pixels;
+            };
+
+            bool tier_changed = false;
+            for (int i = 0; i <= max_down_price && !tier_changed; ++i) {
+              app.input_simulator.left_click();
+              app.sleep(50);
+              auto band = app.borrow_dfwin_roi(band_roi);
+              tier_changed = roi_checksum(band.image()) != band_checksum &&
+                             changed(band_start, band.image());
             }
-            app.input_simulator.left_click();
-            app.sleep(50);
-            auto end = app.capture_dfwin();
-            cv::Mat diff;
-            cv::absdiff(start, end, diff);
-            cv::cvtColor(diff, diff, cv::COLOR_BGR2GRAY);
-            cv::threshold(diff, diff, 5, 30, cv::THRESH_BINARY);
-            // only compare the lower 65%
-            if (cv::countNonZero(
-                    diff(cv::Rect(0, diff.rows * 0.35, diff.cols * 0.57,
-                                  diff.rows * 0.65 - 1))) > 600) {
-              break;
+            if (!tier_changed) {
+              tier_changed =
+                  changed(wide_start, app.borrow_dfwin_roi(wide_roi).image());
+            }
+            if (!tier_changed) {
+              // clicking on would only lower the price further without us
+              // seeing it, leave the item unlisted
+              std::println("[warehouse] price tier never changed, listing "
+                           "aborted");
+              app.move_to_abs(10, 10);
+              app.input_simulator.left_click();
+              app.sleep(300);
+              continue;
             }
-          }
 
-          auto btn_upshelf =
-              app.wait_for_image("warehouse/btn_sell_market_upshelf.png");
+            auto btn_upshelf = sync_wait(market_dialog.wait_for(
+                "warehouse/btn_sell_market_upshelf.png"));
 
-          if (btn_upshelf) {
-            app.move_to_abs(btn_upshelf.value());
-            app.input_simulator.left_click();
-            app.sleep(300);
-            continue;
+            if (btn_upshelf) {
+              app.move_to_abs(
+                  app.rect_to_relpos(*btn_upshelf, App::RelPos::Center));
+              app.input_simulator.left_click();
+              app.sleep(300);
+              continue;
+            }
           }
         }
       }
+
+      std::println("[warehouse] failed to sell item: {}", item);
+      app.move_to_abs(10, 10);
+      app.input_simulator.left_click();
+      app.sleep(300);
     }
+  }
 
-    std::println("[warehouse] failed to sell item: {}", item);
-    app.move_to_abs(10, 10);
-    app.input_simulator.left_click();
-    app.sleep(300);
+  auto frame_stats = app.frame_cache_stats();
+  std::println("[warehouse] frames captured: {}, reused: {}",
+               frame_stats.captured, frame_stats.reused);
+  auto buffer_stats = app.screen_capture.buffer_pool().stats();
+  std::println("[warehouse] frame buffers: {} allocated ({:.1f} MiB), {} "
+               "reused, {} pooled",
+               buffer_stats.allocations,
+               buffer_stats.allocated_bytes / 1024.0 / 1024.0,
+               buffer_stats.reuses, buffer_stats.buffers);
+  app.runtime.pool.log_stats();
+
+  for (auto [name, layout] : {std::pair{"item popup", &item_popup},
+                              std::pair{"sell dialog", &sell_dialog},
+                              std::pair{"market dialog", &market_dialog}}) {
+    auto stats = layout->stats();
+    std::println("[warehouse] {} layout: {} derived, {} searched", name,
+                 stats.derived, stats.searched);
   }
 
   return items;
@@ -2,11 +2,35 @@
 #include "opencv2/opencv.hpp"
 
 #include "../utils/derive_format.hpp"
+#include "dialog_layout.h"
+#include "item_index.h"
+#include "price_store.h"
+#include "sell_planner.h"
+#include "warehouse_mosaic.h"
+#include "warehouse_snapshot.h"
+
+#include <chrono>
 namespace dfg {
 struct App;
 
 struct WarehouseManager {
   App &app;
+  ItemIndex item_index{"./data/item_index.txt"};
+  PriceStore price_store{"./data/prices.bin"};
+  WarehouseSnapshot snapshot{"./data/warehouse_snapshot.txt"};
+  DialogLayout item_popup{app, "warehouse/btn_sell.png"};
+  DialogLayout sell_dialog{app, "warehouse/sell_ui/text_system_price.png"};
+  DialogLayout market_dialog{app,
+                             "warehouse/btn_sell_market_minus_price.png"};
+  // Prices observed within this window are trusted without reopening the
+  // sell dialog.
+  std::chrono::seconds price_max_age = std::chrono::hours(12);
+  // Capture the whole grid before hovering anything, so rows that need no
+  // interaction are settled offline. Only done when the snapshot of a
+  // previous scan has cells to compare with.
+  bool mosaic_scan = true;
+  // Stop scanning after this many whole pages without any item.
+  int empty_pages_to_stop = 1;
 
   struct GridDetectionResult {
     int start_x, start_y;
@@ -15,6 +39,8 @@ struct WarehouseManager {
     cv::Mat visualize(cv::Mat on);
   };
 
+  // The grid never moves within a session, so the result is cached and only
+  // revalidated against a few pixels of the corner markers.
   GridDetectionResult detect_warehouse_grid();
   
   struct ItemInfo: derive_format {
@@ -35,5 +61,11 @@ struct WarehouseManager {
   };
 
   std::vector<ItemInfo> get_items();
+
+  bool grid_still_valid(const FrameContext &frame) const;
+
+  std::optional<GridDetectionResult> cached_grid;
+  // gray value of sample points on the corner markers at detection time
+  std::vector<std::pair<cv::Point, uint8_t>> grid_samples;
 };
 } // namespace dfg
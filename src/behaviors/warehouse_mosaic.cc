@@ -0,0 +1,87 @@
+#include "warehouse_mosaic.h"
+#include "warehouse_snapshot.h"
+
+#include <algorithm>
+#include <numeric>
+#include <print>
+
+namespace dfg {
+WarehouseMosaic::WarehouseMosaic(WorkStealingPool &pool, int rows,
+                                 int cell_width, int cell_height)
+    : pool(&pool), row_count(rows), cell_width(cell_width),
+      cell_height(cell_height),
+      image(rows * cell_height, cols * cell_width, CV_8UC4,
+            cv::Scalar(0, 0, 0, 255)),
+      cells(rows * cols) {}
+
+void WarehouseMosaic::add_page(const cv::Mat &grid_region, int first_row) {
+  int page_rows = grid_region.rows / cell_height;
+  for (int i = 0; i < page_rows; ++i) {
+    int row = first_row + i;
+    if (row < 0 || row >= row_count) {
+      continue;
+    }
+    grid_region(cv::Rect(0, i * cell_height, cols * cell_width, cell_height))
+        .copyTo(image(cv::Rect(0, row * cell_height, cols * cell_width,
+                               cell_height)));
+    for (int x = 0; x < cols; ++x) {
+      cells[row * cols + x].captured = true;
+    }
+  }
+}
+
+void WarehouseMosaic::analyze_rows(int first_row, int count) {
+  first_row = std::max(first_row, 0);
+  int last_row = std::min(first_row + count, row_count);
+  if (last_row <= first_row) {
+    return;
+  }
+
+  std::vector<int> indices((last_row - first_row) * cols);
+  std::iota(indices.begin(), indices.end(), first_row * cols);
+
+  pool->parallel_for(
+      indices.size(),
+      [this, &indices](size_t i) {
+        auto index = indices[i];
+        auto &cell = cells[index];
+        if (!cell.captured) {
+          return;
+        }
+        auto slot = region(index % cols, index / cols, 1, 1);
+
+        // same empty-slot test as the interactive scan
+        cv::Mat gray_slot, edges;
+        cv::cvtColor(slot, gray_slot, cv::COLOR_BGR2GRAY);
+        cv::Canny(gray_slot, edges, 50, 150);
+        cell.empty = cv::countNonZero(edges) < 7;
+        cell.hash = WarehouseSnapshot::cell_hash(slot);
+      },
+      Priority::Normal, "mosaic");
+
+  auto occupied = std::count_if(
+      indices.begin(), indices.end(),
+      [this](int index) { return cells[index].captured && !cells[index].empty; });
+  std::println("[mosaic] analyzed rows {}-{}, {} occupied cells", first_row,
+               last_row - 1, occupied);
+}
+
+bool WarehouseMosaic::rows_empty(int first_row, int count) const {
+  for (int y = std::max(first_row, 0);
+       y < std::min(first_row + count, row_count); ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (cell(x, y).captured && !cell(x, y).empty) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+cv::Mat WarehouseMosaic::region(int x, int y, int width, int height) const {
+  auto rect = cv::Rect(x * cell_width, y * cell_height, width * cell_width,
+                       height * cell_height) &
+              cv::Rect(0, 0, image.cols, image.rows);
+  return image(rect);
+}
+} // namespace dfg
@@ -0,0 +1,48 @@
+#pragma once
+#include "../runtime/thread_pool.h"
+#include "opencv2/opencv.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace dfg {
+// The whole warehouse grid stitched from page captures, one cell row of the
+// mosaic per warehouse row. Once every page is added, analyze() classifies all
+// cells in parallel on the pool, so the scan only has to drive the UI for what
+// the analysis cannot answer.
+struct WarehouseMosaic {
+  struct Cell {
+    bool captured = false;
+    bool empty = true;
+    // WarehouseSnapshot::cell_hash of the cell
+    uint64_t hash = 0;
+  };
+
+  static constexpr int cols = 9;
+
+  WarehouseMosaic(WorkStealingPool &pool, int rows, int cell_width,
+                  int cell_height);
+
+  // Copies a capture of the grid region whose first row is warehouse row
+  // first_row. Rows outside the mosaic are ignored.
+  void add_page(const cv::Mat &grid_region, int first_row);
+  void analyze() { analyze_rows(0, row_count); }
+  // Analyzes only rows [first_row, first_row + count), e.g. a fresh page.
+  void analyze_rows(int first_row, int count);
+  // True if every captured cell in the rows is empty.
+  bool rows_empty(int first_row, int count) const;
+
+  int rows() const { return row_count; }
+  const Cell &cell(int x, int y) const { return cells[y * cols + x]; }
+  // The mosaic pixels covered by a cell rectangle, in grid units.
+  cv::Mat region(int x, int y, int width, int height) const;
+
+private:
+  // a pointer, so a mosaic can be assigned, e.g. into an optional
+  WorkStealingPool *pool;
+  int row_count;
+  int cell_width, cell_height;
+  cv::Mat image;
+  std::vector<Cell> cells;
+};
+} // namespace dfg
@@ -0,0 +1,115 @@
+#include "warehouse_snapshot.h"
+
+#include <bit>
+#include <fstream>
+#include <print>
+
+namespace dfg {
+static constexpr int warehouse_snapshot_version = 1;
+// hash bits allowed to differ, absorbs capture noise and subtle animations
+static constexpr int max_cell_distance = 4;
+
+void WarehouseSnapshot::load() {
+  cells.clear();
+  items.clear();
+  std::ifstream in(path);
+  if (!in) {
+    return;
+  }
+
+  std::string magic;
+  int version = 0;
+  if (!(in >> magic >> version) || magic != "warehouse_snapshot" ||
+      version != warehouse_snapshot_version) {
+    std::println("[snapshot] {} has an old format, ignored", path.string());
+    return;
+  }
+
+  std::string kind;
+  while (in >> kind) {
+    if (kind == "cell") {
+      int x, y;
+      uint64_t hash;
+      if (!(in >> x >> y >> hash)) {
+        break;
+      }
+      record_cell(x, y, hash);
+    } else if (kind == "item") {
+      Item item;
+      if (!(in >> item.x >> item.y >> item.width >> item.height >>
+            item.quality)) {
+        break;
+      }
+      record_item(item);
+    } else {
+      break;
+    }
+  }
+  std::println("[snapshot] loaded {} cells, {} items from {}", cells.size(),
+               items.size(), path.string());
+}
+
+void WarehouseSnapshot::save() const {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream out(path, std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Failed to write warehouse snapshot: " +
+                             path.string());
+  }
+
+  std::println(out, "warehouse_snapshot {}", warehouse_snapshot_version);
+  for (const auto &[key, hash] : cells) {
+    std::println(out, "cell {} {} {}", key % 16, key / 16, hash);
+  }
+  for (const auto &[key, item] : items) {
+    std::println(out, "item {} {} {} {} {}", item.x, item.y, item.width,
+                 item.height, item.quality);
+  }
+}
+
+uint64_t WarehouseSnapshot::cell_hash(const cv::Mat &cell) {
+  cv::Mat gray, small;
+  if (cell.channels() == 1) {
+    gray = cell;
+  } else {
+    cv::cvtColor(cell, gray, cv::COLOR_BGR2GRAY);
+  }
+  cv::resize(gray, small, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+
+  uint64_t hash = 0;
+  for (int y = 0; y < 8; ++y) {
+    auto row = small.ptr<uint8_t>(y);
+    for (int x = 0; x < 8; ++x) {
+      if (row[x] < row[x + 1]) {
+        hash |= 1ull << (y * 8 + x);
+      }
+    }
+  }
+  return hash;
+}
+
+bool WarehouseSnapshot::same_cell(uint64_t a, uint64_t b) {
+  return std::popcount(a ^ b) <= max_cell_distance;
+}
+
+void WarehouseSnapshot::record_cell(int x, int y, uint64_t hash) {
+  cells[cell_key(x, y)] = hash;
+}
+
+void WarehouseSnapshot::record_item(const Item &item) {
+  items[cell_key(item.x, item.y)] = item;
+}
+
+std::optional<uint64_t> WarehouseSnapshot::cell(int x, int y) const {
+  auto it = cells.find(cell_key(x, y));
+  if (it == cells.end()) {
+    return {};
+  }
+  return it->second;
+}
+
+const WarehouseSnapshot::Item *WarehouseSnapshot::item_at(int x, int y) const {
+  auto it = items.find(cell_key(x, y));
+  return it == items.end() ? nullptr : &it->second;
+}
+} // namespace dfg
@@ -0,0 +1,48 @@
+#pragma once
+#include "opencv2/opencv.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
+
+namespace dfg {
+// Per-cell record of the last warehouse scan: a hash of every visited cell and
+// the footprint and quality of every item. A later scan that finds the same
+// cell hashes can reuse the item instead of hovering it again.
+struct WarehouseSnapshot {
+  struct Item {
+    int x, y;
+    int width, height;
+    int quality;
+  };
+
+  WarehouseSnapshot() = default;
+  explicit WarehouseSnapshot(std::filesystem::path path)
+      : path(std::move(path)) {}
+
+  void load();
+  void save() const;
+  // An empty snapshot that will be saved to the same file.
+  WarehouseSnapshot next() const { return WarehouseSnapshot(path); }
+
+  // 64 bit difference hash of one grid cell, given in color or gray.
+  static uint64_t cell_hash(const cv::Mat &cell);
+  static bool same_cell(uint64_t a, uint64_t b);
+
+  void record_cell(int x, int y, uint64_t hash);
+  void record_item(const Item &item);
+  std::optional<uint64_t> cell(int x, int y) const;
+  // Item whose top-left cell is (x, y).
+  const Item *item_at(int x, int y) const;
+  // Whether any cell was recorded, i.e. whether a scan can reuse anything.
+  bool has_cells() const { return !cells.empty(); }
+
+private:
+  static int cell_key(int x, int y) { return y * 16 + x; }
+
+  std::filesystem::path path;
+  std::unordered_map<int, uint64_t> cells;
+  std::unordered_map<int, Item> items;
+};
+} // namespace dfg
@@ -3,63 +3,217 @@
 #include "opencv2/highgui.hpp"
 #include <cpptrace/cpptrace.hpp>
 #include <cpptrace/from_current.hpp>
+#include <algorithm>
 #include <exception>
 #include <filesystem>
+#include <future>
 #include <unordered_map>
 
+#include <psapi.h>
+
 namespace dfg {
-cv::Mat App::capture_dfwin() {
+std::optional<FrameContext> App::cached_frame() {
+  auto epoch = InputSimulator::last_epoch();
+  std::lock_guard lock(frame_cache_mutex);
+  // 100ns ticks, like the frame timestamps
+  auto max_age = std::chrono::duration_cast<
+                     std::chrono::duration<int64_t, std::ratio<1, 10000000>>>(
+                     frame_cache_max_age)
+                     .count();
+  if (last_frame.empty() || last_frame_epoch != epoch.id ||
+      last_frame.timestamp() <= epoch.time ||
+      system_relative_time() - last_frame.timestamp() > max_age) {
+    return {};
+  }
+  frame_cache_counters.reused++;
+  return last_frame;
+}
+
+FrameContext App::capture_frame(bool allow_cached) {
   if (!df_window) {
     throw std::runtime_error("Delta Force window not initialized");
   }
-  auto res = screen_capture.capture_window(df_window);
+  if (allow_cached) {
+    if (auto cached = cached_frame()) {
+      return *cached;
+    }
+  }
+
+  // read before capturing, so input sent meanwhile invalidates the frame
+  auto epoch = InputSimulator::last_epoch();
+  int64_t captured_time = 0;
+  auto res =
+      screen_capture.capture_window(df_window, std::nullopt, &captured_time);
   if (res.empty()) {
     throw std::runtime_error("Failed to capture Delta Force window");
   }
 
-  if (scale != 1) {
-    cv::resize(res, res, cv::Size(), scale, scale, cv::INTER_LINEAR);
+  // no color resize here, views come out at develop size on their own
+  FrameContext frame(std::move(res), captured_time, window_geometry.scale(),
+                     &screen_capture.buffer_pool());
+  if (capture_gray) {
+    frame.build_gray();
   }
+  std::lock_guard lock(frame_cache_mutex);
+  last_frame = frame;
+  last_frame_epoch = epoch.id;
+  frame_cache_counters.captured++;
+  return frame;
+}
 
-  return res;
+cv::Mat App::capture_dfwin(bool allow_cached, int64_t *frame_time) {
+  auto frame = capture_frame(allow_cached);
+  if (frame_time) {
+    *frame_time = frame.timestamp();
+  }
+  return frame.bgra();
 }
 
-void App::init() {
-  ocr.initialize();
-  SetProcessDPIAware();
-  SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+App::FrameCacheStats App::frame_cache_stats() {
+  std::lock_guard lock(frame_cache_mutex);
+  return frame_cache_counters;
+}
 
-  df_window = FindWindowW(L"UnrealWindow", nullptr);
-  if (!df_window) {
-    throw std::runtime_error("Delta Force window not found");
+FrameContext App::capture_frame_after(InputEpoch epoch, int max_wait) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(max_wait);
+  for (bool first = true;; first = false) {
+    // capture_frame already waits for the next frame, no sleep needed
+    auto frame = capture_frame(first);
+    if (frame.timestamp() > epoch.time ||
+        std::chrono::steady_clock::now() > deadline) {
+      return frame;
+    }
   }
+}
+
+std::optional<FrameContext> App::wait_for_change(InputEpoch epoch,
+                                                 const FrameContext &baseline,
+                                                 cv::Rect roi,
+                                                 int min_changed_pixels,
+                                                 int max_wait) {
+  roi &= cv::Rect(0, 0, baseline.cols(), baseline.rows());
+  auto baseline_gray = baseline.gray(roi);
 
-  RECT rect;
-  if (!GetClientRect(df_window, &rect)) {
-    throw std::runtime_error("Failed to get Delta Force client rect");
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(max_wait);
+  for (bool first = true; std::chrono::steady_clock::now() <= deadline;
+       first = false) {
+    auto frame = capture_frame(first);
+    if (frame.timestamp() <= epoch.time) {
+      continue;
+    }
+    cv::Mat diff;
+    cv::absdiff(baseline_gray, frame.gray(roi), diff);
+    if (cv::countNonZero(diff > 5) > min_changed_pixels) {
+      return frame;
+    }
   }
+  return {};
+}
 
-  int width = rect.right - rect.left;
-  int height = rect.bottom - rect.top;
-  if (width <= 0 || height <= 0) {
-    throw std::runtime_error("Invalid Delta Force window size");
+// Runs one startup phase and logs how long it took.
+template <typename F> static void timed_phase(std::string_view name, F &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto elapsed = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start);
+  std::println("[app] {} ready in {:.1f} ms", name, elapsed.count());
+}
+
+cv::Mat App::capture_dfwin_roi(cv::Rect roi) {
+  return screen_capture.buffer_pool().copy(borrow_dfwin_roi(roi).image());
+}
+
+BorrowedFrame App::borrow_dfwin_roi(cv::Rect roi) {
+  if (!df_window) {
+    throw std::runtime_error("Delta Force window not initialized");
   }
+  auto scale = window_geometry.scale();
+  auto native_roi = cv::Rect(static_cast<int>(roi.x / scale),
+                             static_cast<int>(roi.y / scale),
+                             static_cast<int>(roi.width / scale),
+                             static_cast<int>(roi.height / scale));
+  // not resampled, the caller only compares captures of the same roi
+  auto res = screen_capture.borrow_window(df_window, native_roi);
+  if (res.empty()) {
+    throw std::runtime_error("Failed to capture Delta Force window");
+  }
+  return res;
+}
 
-  actual_df_width = develop_df_width;
-  actual_df_height = develop_df_height;
+void App::init() {
+  auto start = std::chrono::steady_clock::now();
+
+  // startup phases run on the shared pool, ahead of any other work
+  auto phase = [this](std::string_view name, auto fn) {
+    return runtime.pool.submit([name, fn] { timed_phase(name, fn); },
+                               Priority::Interactive, "startup");
+  };
+  auto ocr_phase = phase("ocr", [this] { ocr.initialize(); });
+  auto templates_phase = phase("templates", [this] { preload_images(); });
+  auto item_index_phase = phase(
+      "item index", [this] { warehouse_manager.item_index.load(); });
+  auto price_store_phase = phase(
+      "price store", [this] { warehouse_manager.price_store.open(); });
+  auto snapshot_phase =
+      phase("snapshot", [this] { warehouse_manager.snapshot.load(); });
+
+  timed_phase("window", [this] {
+    focus_maximize_df();
+    SetProcessDPIAware();
+    SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+    // the simulator was built before DPI awareness, with virtualized metrics
+    input_simulator.refresh_metrics();
 
-  scale = 1;
+    RECT rect;
+    if (!GetClientRect(df_window, &rect)) {
+      throw std::runtime_error("Failed to get Delta Force client rect");
+    }
+
+    int width = rect.right - rect.left;
+    int height = rect.bottom - rect.top;
+    if (width <= 0 || height <= 0) {
+      throw std::runtime_error("Invalid Delta Force window size");
+    }
 
-  SetWindowPos(df_window, nullptr, 0, 0, actual_df_width, actual_df_height,
-               SWP_NOZORDER | SWP_NOMOVE | SWP_NOACTIVATE);
+    // size the client area, which is what is captured and mapped, to the
+    // develop resolution; the outer window adds its borders and title bar
+    RECT outer = {0, 0, develop_df_width, develop_df_height};
+    AdjustWindowRectEx(&outer, GetWindowLong(df_window, GWL_STYLE), FALSE,
+                       GetWindowLong(df_window, GWL_EXSTYLE));
+    SetWindowPos(df_window, nullptr, 0, 0, outer.right - outer.left,
+                 outer.bottom - outer.top,
+                 SWP_NOZORDER | SWP_NOMOVE | SWP_NOACTIVATE);
+    window_geometry.attach(make_win32_geometry_provider(df_window));
 
-  std::println("[app] Delta Force Window size: {}x{}, scale: {:.2f}",
-               actual_df_width, actual_df_height, scale);
+    auto window_rect = window_geometry.rect();
+    std::println("[app] Delta Force Window size: {}x{}, scale: {:.2f}",
+                 window_rect.width, window_rect.height,
+                 window_geometry.scale());
+  });
+
+  // the capture session needs the final window size
+  auto capture_phase =
+      phase("capture", [this] { screen_capture.warm_up(df_window); });
+
+  ocr_phase.get();
+  templates_phase.get();
+  item_index_phase.get();
+  price_store_phase.get();
+  snapshot_phase.get();
+  capture_phase.get();
+  // needs both the templates and the final window size
+  timed_phase("scaled templates", [this] { prepare_templates(); });
+
+  auto elapsed = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start);
+  std::println("[app] startup finished in {:.1f} ms", elapsed.count());
 }
 
 App::App() {}
 cv::Mat App::load_img(std::string path) {
-  static std::unordered_map<std::string, cv::Mat> img_cache;
+  std::lock_guard lock(img_cache_mutex);
   if (img_cache.find(path) == img_cache.end()) {
     cv::Mat img = cv::imread("./images/" + path, cv::IMREAD_UNCHANGED);
     if (img.empty()) {
@@ -70,32 +224,105 @@ cv::Mat App::load_img(std::string path) {
   }
   return img_cache[path];
 }
-void App::move_to_abs(int x, int y) {
-  RECT rect;
-  if (!GetWindowRect(df_window, &rect)) {
-    throw std::runtime_error("Failed to get Delta Force window rect");
+void App::preload_images() {
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator("./images")) {
+    if (entry.is_regular_file() && entry.path().extension() == ".png") {
+      load_img(std::filesystem::relative(entry.path(), "./images")
+                   .generic_string());
+    }
+  }
+}
+cv::Mat App::load_template(const std::string &path, float scale) {
+  {
+    std::lock_guard lock(template_cache_mutex);
+    auto &variants = template_cache[scale];
+    if (auto it = variants.find(path); it != variants.end()) {
+      return it->second;
+    }
+  }
+
+  cv::Mat img = load_img(path);
+  cv::Mat img_gray;
+  cv::cvtColor(img, img_gray, cv::COLOR_BGR2GRAY);
+  if (scale != 1) {
+    auto size = cv::Size(std::max(1, cvRound(img.cols / scale)),
+                         std::max(1, cvRound(img.rows / scale)));
+    cv::resize(img_gray, img_gray, size, 0, 0,
+               scale > 1 ? cv::INTER_AREA : cv::INTER_LINEAR);
   }
 
-  // scale back
-  x = static_cast<int>(x / scale) + rect.left;
-  y = static_cast<int>(y / scale) + rect.top;
-  input_simulator.move_to(x, y, 50);
+  std::lock_guard lock(template_cache_mutex);
+  template_cache[scale][path] = img_gray;
+  return img_gray;
+}
+void App::prepare_templates() {
+  std::vector<std::string> paths;
+  {
+    std::lock_guard lock(img_cache_mutex);
+    for (const auto &[path, img] : img_cache) {
+      paths.push_back(path);
+    }
+  }
+  auto scale = window_geometry.scale();
+  for (const auto &path : paths) {
+    load_template(path, scale);
+  }
+}
+InputEpoch App::move_to_abs(int x, int y, int duration_ms) {
+  auto screen = window_geometry.to_screen({x, y});
+  return input_simulator.move_to(screen.x, screen.y, duration_ms);
 }
 std::optional<cv::Rect> App::locate_image_rect(std::string path,
                                                float threshold) {
+  return locate_image_rect(capture_frame(), path, threshold);
+}
+bool App::image_at(const cv::Mat &screen, std::string path, cv::Rect rect,
+                   float threshold) {
+  return image_at(FrameContext(screen), std::move(path), rect, threshold);
+}
+bool App::image_at(const FrameContext &frame, std::string path, cv::Rect rect,
+                   float threshold) {
   cv::Mat img = load_img(path);
-  cv::Mat screen = capture_dfwin();
-  if (screen.empty()) {
-    throw std::runtime_error("Failed to capture Delta Force window");
+  if (rect.size() != img.size() ||
+      (rect & cv::Rect(0, 0, frame.cols(), frame.rows())) != rect) {
+    return false;
   }
 
-  // grayscale the images
-  cv::Mat img_gray, screen_gray;
-  cv::cvtColor(img, img_gray, cv::COLOR_BGR2GRAY);
-  cv::cvtColor(screen, screen_gray, cv::COLOR_BGR2GRAY);
-  // match template
+  // checked at the native resolution, against the template's variant there
+  auto scale = frame.scale();
+  cv::Mat img_gray = load_template(path, scale);
+  auto native_rect = cv::Rect(cvRound(rect.x / scale),
+                              cvRound(rect.y / scale), img_gray.cols,
+                              img_gray.rows) &
+                     cv::Rect({}, frame.native().size());
+  if (native_rect.size() != img_gray.size()) {
+    return false;
+  }
+
+  // a same-size match yields the single correlation value at rect
   cv::Mat result;
-  cv::matchTemplate(screen_gray, img_gray, result, cv::TM_CCOEFF_NORMED);
+  cv::matchTemplate(frame.native_gray()(native_rect), img_gray, result,
+                    cv::TM_CCOEFF_NORMED);
+  return result.at<float>(0, 0) >= threshold;
+}
+std::optional<cv::Rect> App::locate_image_rect(const cv::Mat &screen,
+                                               std::string path,
+                                               float threshold) {
+  return locate_image_rect(FrameContext(screen), std::move(path), threshold);
+}
+std::optional<cv::Rect> App::locate_image_rect(const FrameContext &frame,
+                                               std::string path,
+                                               float threshold) {
+  cv::Mat img = load_img(path);
+
+  // match in the frame's native resolution with the template scaled to it,
+  // the frame itself is never resampled
+  auto scale = frame.scale();
+  cv::Mat img_gray = load_template(path, scale);
+  cv::Mat result;
+  cv::matchTemplate(frame.native_gray(), img_gray, result,
+                    cv::TM_CCOEFF_NORMED);
   // find locations with high enough correlation
   cv::Point match_loc;
   double max_val;
@@ -104,7 +331,9 @@ std::optional<cv::Rect> App::locate_image_rect(std::string path,
     return {};
   }
 
-  return cv::Rect(match_loc.x, match_loc.y, img.cols, img.rows);
+  // back to develop coordinates, at the template's develop size
+  return cv::Rect(cvRound(match_loc.x * scale), cvRound(match_loc.y * scale),
+                  img.cols, img.rows);
 }
 cv::Point App::rect_to_relpos(cv::Rect rect, RelPos pos) {
   switch (pos) {
@@ -147,8 +376,10 @@ void App::focus_df() {
 std::optional<cv::Rect> App::wait_for_image_rect(std::string path, int max_wait,
                                                  float threshold) {
   auto start_time = std::chrono::steady_clock::now();
-  while (true) {
-    auto rect = locate_image_rect(path, threshold);
+  for (bool first = true;; first = false) {
+    // only the first attempt may look at a cached frame, later ones wait for
+    // the screen to change
+    auto rect = locate_image_rect(capture_frame(first), path, threshold);
     if (rect) {
       return rect;
     }
@@ -159,6 +390,41 @@ std::optional<cv::Rect> App::wait_for_image_rect(std::string path, int max_wait,
     sleep(10);
   }
 }
+Task<std::optional<cv::Rect>> App::image(std::string path, int max_wait,
+                                         float threshold) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(max_wait);
+  for (bool first = true;; first = false) {
+    co_await schedule_on(runtime.pool, Priority::Interactive, "image");
+    if (auto rect = locate_image_rect(capture_frame(first), path, threshold)) {
+      co_return rect;
+    }
+    if (std::chrono::steady_clock::now() > deadline) {
+      co_return std::nullopt;
+    }
+    co_await sleep_for(runtime.timers, std::chrono::milliseconds(10));
+  }
+}
+
+Task<cv::Mat> App::stable(cv::Rect roi, int max_wait) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(max_wait);
+  co_await schedule_on(runtime.pool, Priority::Interactive, "stable");
+  // compared in place, only the settled crop is copied out
+  auto previous = borrow_dfwin_roi(roi);
+  while (true) {
+    co_await sleep_for(runtime.timers, std::chrono::milliseconds(10));
+    auto current = borrow_dfwin_roi(roi);
+    cv::Mat diff;
+    cv::absdiff(previous.image(), current.image(), diff);
+    if (cv::countNonZero(diff.reshape(1) > 5) == 0 ||
+        std::chrono::steady_clock::now() > deadline) {
+      co_return screen_capture.buffer_pool().copy(current.image());
+    }
+    previous = std::move(current);
+  }
+}
+
 std::optional<cv::Point> App::locate_image(std::string path, RelPos result_pos,
                                            float threshold) {
   auto rect = locate_image_rect(path, threshold);
@@ -196,6 +462,38 @@ int onOpenCVError(int status, const char *func_name, const char *err_msg,
                            std::to_string(line));
 }
 
+// Measures how long the OCR subsystem takes to become usable and how much
+// resident memory it adds, for every model shipped in ./models.
+static int bench_ocr_startup() {
+  auto working_set = []() -> size_t {
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.WorkingSetSize;
+  };
+
+  constexpr int runs = 5;
+  for (std::string language : {"digits", "eng"}) {
+    if (!std::filesystem::exists("./models/" + language + ".traineddata")) {
+      std::println("[bench] model {} not found, skipped", language);
+      continue;
+    }
+
+    for (int i = 0; i < runs; ++i) {
+      auto mem_before = working_set();
+      auto start = std::chrono::steady_clock::now();
+      dfg::OCR ocr;
+      ocr.initialize(language);
+      auto elapsed = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start);
+      auto mem_after = working_set();
+      std::println("[bench] ocr startup {} #{}: {:.1f} ms, {:+.1f} MiB",
+                   language, i, elapsed.count(),
+                   (double(mem_after) - double(mem_before)) / 1024 / 1024);
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
   SetConsoleOutputCP(CP_UTF8);
   cv::redirectError(onOpenCVError);
@@ -204,11 +502,13 @@ int main(int argc, char *argv[]) {
 
   std::set_terminate([]() { cpptrace::stacktrace::current().print(); });
 
+  if (argc > 1 && std::string_view(argv[1]) == "--bench-ocr-startup") {
+    return bench_ocr_startup();
+  }
+
   dfg::App app;
   CPPTRACE_TRY {
-    app.focus_maximize_df();
     app.init();
-    auto mat = app.capture_dfwin();
     std::println("items: {}", app.warehouse_manager.get_items());
   }
   CPPTRACE_CATCH(const std::runtime_error &e) {
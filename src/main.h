@@ -1,12 +1,19 @@
 #pragma once
 #include "opencv2/opencv.hpp"
+#include <chrono>
 #include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <print>
+#include <unordered_map>
 
+#include "./automation/frame_context.h"
 #include "./automation/ocr.h"
 #include "./automation/input_simulator.h"
 #include "./automation/screen_capture.h"
+#include "./automation/window_geometry.h"
+#include "./runtime/runtime.h"
 
 #include "./behaviors/warehouse_manager.h"
 
@@ -20,28 +27,81 @@ struct App {
   OCR ocr;
 
   HWND df_window;
-  // Scale is the scale from the real window size to the size when reference
-  // image is taken (develop_df_width, develop_df_height). The bigger the window
-  // is, the smaller the scale is. This is used to scale mouse coordinates and
-  // image matching.
-  float scale = 1;
   static constexpr int develop_df_width = 1920;
   static constexpr int develop_df_height = 1080;
-  int actual_df_width = 0;
-  int actual_df_height = 0;
+  // Position of the window and its scale to the size when reference images
+  // were taken (develop_df_width, develop_df_height). Used to scale mouse
+  // coordinates and image matching.
+  WindowGeometry window_geometry{{develop_df_width, develop_df_height}};
 
   WarehouseManager warehouse_manager{*this};
 
+  Runtime runtime;
+
+  std::chrono::milliseconds frame_cache_max_age{50};
+  // Build the gray view of every frame right after capturing it. Most
+  // matching only needs gray, so the color frame is rarely touched again.
+  bool capture_gray = true;
+  struct FrameCacheStats {
+    // frames actually captured from the window
+    size_t captured = 0;
+    // captures answered with the cached frame
+    size_t reused = 0;
+  };
+  FrameCacheStats frame_cache_stats();
+
   App();
+  // Brings up the window, OCR, templates and capture session. Independent
+  // phases run concurrently, so startup costs as much as the slowest one.
   void init();
+  // Loads every template under ./images into the image cache.
+  void preload_images();
+  // Makes the matching variant of every loaded template for the current
+  // window scale, see load_template.
+  void prepare_templates();
   // The image is scaled to the develop_df_width
   // and develop_df_height, so it can be used by image matching algorithms.
-  cv::Mat capture_dfwin();
+  // With allow_cached the last frame is returned again if no input was sent
+  // since it was rendered and it is younger than frame_cache_max_age. Its
+  // derived views are shared with every other user of the same frame. Polling
+  // loops should only allow the cache on their first attempt.
+  FrameContext capture_frame(bool allow_cached = true);
+  // The BGRA pixels of capture_frame. frame_time receives the frame's
+  // timestamp, see InputEpoch. Treat the result as read-only, it may be
+  // shared with later calls.
+  cv::Mat capture_dfwin(bool allow_cached = true,
+                        int64_t *frame_time = nullptr);
+  // The first frame rendered after the input epoch. Falls back to the latest
+  // frame once max_wait ms have passed.
+  FrameContext capture_frame_after(InputEpoch epoch, int max_wait = 500);
+  // Waits for the first frame after epoch whose roi differs from baseline in
+  // more than min_changed_pixels pixels, i.e. for the input to actually show
+  // on screen instead of sleeping a guessed latency.
+  std::optional<FrameContext> wait_for_change(InputEpoch epoch,
+                                              const FrameContext &baseline,
+                                              cv::Rect roi,
+                                              int min_changed_pixels = 0,
+                                              int max_wait = 500);
+  // Captures only roi, given in develop coordinates like everything else. The
+  // pixels stay at the window's native resolution, so compare the result only
+  // with other captures of the same roi; pixel counts scale by
+  // window_geometry.scale() squared.
+  cv::Mat capture_dfwin_roi(cv::Rect roi);
+  // Same as capture_dfwin_roi, but the pixels are read in place from the
+  // capture's staging memory, see BorrowedFrame. Use it for crops that are
+  // only compared and then dropped.
+  BorrowedFrame borrow_dfwin_roi(cv::Rect roi);
   cv::Mat load_img(std::string path);
+  // The image at path in gray, resized by 1 / scale to a frame's native
+  // resolution, so frames are matched as captured instead of being resampled
+  // to the develop size. Variants are made once per scale and kept.
+  cv::Mat load_template(const std::string &path, float scale);
   // Move mouse to absolute position in Delta Force window coordinates
-  // This function will also process the scale factor.
-  void move_to_abs(int x, int y);
-  inline void move_to_abs(cv::Point p) { move_to_abs(p.x, p.y); }
+  // This function will also process the scale factor, see window_geometry.
+  InputEpoch move_to_abs(int x, int y, int duration_ms = 50);
+  inline InputEpoch move_to_abs(cv::Point p, int duration_ms = 50) {
+    return move_to_abs(p.x, p.y, duration_ms);
+  }
 
   void sleep(int ms, float randomize_rate = 0.2);
   void focus_maximize_df();
@@ -60,6 +120,19 @@ struct App {
 
   std::optional<cv::Rect> locate_image_rect(std::string path,
                                             float threshold = 0.1f);
+  // Same as above, but searches an already captured frame.
+  std::optional<cv::Rect> locate_image_rect(const FrameContext &frame,
+                                            std::string path,
+                                            float threshold = 0.1f);
+  std::optional<cv::Rect> locate_image_rect(const cv::Mat &screen,
+                                            std::string path,
+                                            float threshold = 0.1f);
+  // Cheap check that the image sits exactly at rect in the frame, without
+  // searching for it.
+  bool image_at(const FrameContext &frame, std::string path, cv::Rect rect,
+                float threshold = 0.7f);
+  bool image_at(const cv::Mat &screen, std::string path, cv::Rect rect,
+                float threshold = 0.7f);
   std::optional<cv::Point> locate_image(std::string path,
                                         RelPos result_pos = RelPos::Center,
                                         float threshold = 0.1f);
@@ -72,6 +145,30 @@ struct App {
                                           float threshold = 0.7f);
   cv::Point rect_to_relpos(cv::Rect rect, RelPos pos);
 
+  // Awaitable versions of the waits above. They suspend instead of blocking,
+  // matching runs on runtime.pool at interactive priority.
+  Task<std::optional<cv::Rect>> image(std::string path, int max_wait = 1000,
+                                      float threshold = 0.7f);
+  // Resolves once roi looks the same in consecutive frames, e.g. after an
+  // animation, with the settled crop at native resolution, see
+  // capture_dfwin_roi.
+  Task<cv::Mat> stable(cv::Rect roi, int max_wait = 1000);
+
   void focus_df();
+
+private:
+  std::optional<FrameContext> cached_frame();
+
+  std::mutex frame_cache_mutex;
+  FrameContext last_frame;
+  uint64_t last_frame_epoch = 0;
+  FrameCacheStats frame_cache_counters;
+
+  std::mutex img_cache_mutex;
+  std::unordered_map<std::string, cv::Mat> img_cache;
+
+  std::mutex template_cache_mutex;
+  // by scale, then by path
+  std::map<float, std::unordered_map<std::string, cv::Mat>> template_cache;
 };
 } // namespace dfg
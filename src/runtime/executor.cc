@@ -0,0 +1,94 @@
+#include "executor.h"
+
+namespace dfg {
+
+thread_local Executor *Executor::current_executor = nullptr;
+
+Executor *Executor::current() { return current_executor; }
+
+ThreadPool::ThreadPool(size_t threads) {
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([this] { run(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  job_posted.notify_all();
+  workers.clear();
+}
+
+void ThreadPool::post(std::function<void()> job) {
+  {
+    std::lock_guard lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  job_posted.notify_one();
+}
+
+void ThreadPool::run() {
+  current_executor = this;
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock lock(mutex);
+      job_posted.wait(lock, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty()) {
+        return;
+      }
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+TimerQueue::TimerQueue() : worker([this] { run(); }) {}
+
+TimerQueue::~TimerQueue() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  changed.notify_all();
+}
+
+void TimerQueue::schedule(std::chrono::steady_clock::time_point deadline,
+                          std::coroutine_handle<> handle,
+                          Executor *resume_on) {
+  {
+    std::lock_guard lock(mutex);
+    timers.push({deadline, handle, resume_on});
+  }
+  changed.notify_all();
+}
+
+void TimerQueue::run() {
+  std::unique_lock lock(mutex);
+  while (!stopping) {
+    if (timers.empty()) {
+      changed.wait(lock);
+      continue;
+    }
+    auto timer = timers.top();
+    if (changed.wait_until(lock, timer.deadline) == std::cv_status::no_timeout) {
+      // woken up early, an earlier timer may have been added
+      continue;
+    }
+    timers.pop();
+    lock.unlock();
+    if (timer.resume_on) {
+      timer.resume_on->post([handle = timer.handle] { handle.resume(); });
+    } else {
+      // not started from an executor, e.g. the main thread blocked in
+      // sync_wait, so the timer thread runs it
+      timer.handle.resume();
+    }
+    lock.lock();
+  }
+}
+
+} // namespace dfg
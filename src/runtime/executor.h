@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace dfg {
+
+// Somewhere to run jobs and resume coroutines.
+class Executor {
+public:
+  virtual ~Executor() = default;
+  virtual void post(std::function<void()> job) = 0;
+  // The executor the calling thread belongs to, nullptr outside of one.
+  static Executor *current();
+
+protected:
+  static thread_local Executor *current_executor;
+};
+
+// Fixed number of threads sharing one FIFO queue. With one thread, jobs run
+// strictly in the order they were posted.
+class ThreadPool : public Executor {
+public:
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  void post(std::function<void()> job) override;
+
+private:
+  void run();
+
+  std::mutex mutex;
+  std::condition_variable job_posted;
+  std::deque<std::function<void()>> jobs;
+  bool stopping = false;
+  std::vector<std::jthread> workers;
+};
+
+// One thread resuming sleeping coroutines on their executor once their
+// deadline passed.
+class TimerQueue {
+public:
+  TimerQueue();
+  ~TimerQueue();
+
+  void schedule(std::chrono::steady_clock::time_point deadline,
+                std::coroutine_handle<> handle, Executor *resume_on);
+
+private:
+  struct Timer {
+    std::chrono::steady_clock::time_point deadline;
+    std::coroutine_handle<> handle;
+    Executor *resume_on;
+    bool operator>(const Timer &other) const {
+      return deadline > other.deadline;
+    }
+  };
+  void run();
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers;
+  bool stopping = false;
+  std::jthread worker;
+};
+
+// co_await schedule_on(executor) continues the coroutine on executor.
+inline auto schedule_on(Executor &executor) {
+  struct Awaiter {
+    Executor &executor;
+    bool await_ready() const noexcept {
+      return Executor::current() == &executor;
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+      executor.post([handle] { handle.resume(); });
+    }
+    void await_resume() const noexcept {}
+  };
+  return Awaiter{executor};
+}
+
+// co_await sleep_for(timers, d) suspends for d without blocking a thread, and
+// continues on the executor it was called from.
+inline auto sleep_for(TimerQueue &timers,
+                      std::chrono::steady_clock::duration duration) {
+  struct Awaiter {
+    TimerQueue &timers;
+    std::chrono::steady_clock::duration duration;
+    bool await_ready() const noexcept { return duration.count() <= 0; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      timers.schedule(std::chrono::steady_clock::now() + duration, handle,
+                      Executor::current());
+    }
+    void await_resume() const noexcept {}
+  };
+  return Awaiter{timers, duration};
+}
+
+} // namespace dfg
@@ -0,0 +1,17 @@
+#pragma once
+#include "executor.h"
+#include "task.hpp"
+#include "thread_pool.h"
+
+namespace dfg {
+
+// Executors behaviors run on: vision work (matching, OCR, analysis) on the
+// shared pool, input on its own thread so events never reorder, and the
+// timers behind sleep_for.
+struct Runtime {
+  WorkStealingPool pool;
+  ThreadPool input{1};
+  TimerQueue timers;
+};
+
+} // namespace dfg
@@ -0,0 +1,202 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace dfg {
+
+// A coroutine returning T. Tasks are lazy: they run when awaited, started
+// with start(), or waited for with sync_wait(). A started task keeps running
+// on whatever thread resumes it, and can be awaited or waited for later.
+// Dropping a started task that has not finished detaches it: it runs to
+// completion and frees itself, its result is discarded.
+template <typename T = void> class Task;
+
+namespace detail {
+// Stored in TaskPromise::waiter once the task has finished.
+inline char task_done_marker;
+// Stored in TaskPromise::waiter once the Task was dropped while running.
+inline char task_detached_marker;
+
+template <typename T> struct TaskResult {
+  std::optional<T> value;
+  template <typename U> void return_value(U &&result) {
+    value.emplace(std::forward<U>(result));
+  }
+  T take() { return std::move(*value); }
+};
+template <> struct TaskResult<void> {
+  void return_void() {}
+  void take() {}
+};
+
+template <typename T> struct TaskPromise : TaskResult<T> {
+  // nullptr while running without a waiter, the waiting coroutine's address,
+  // &task_detached_marker once nobody will ever wait, or &task_done_marker
+  // once finished
+  std::atomic<void *> waiter = nullptr;
+  std::exception_ptr exception;
+
+  Task<T> get_return_object();
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<TaskPromise> handle) noexcept {
+      auto previous = handle.promise().waiter.exchange(&task_done_marker);
+      if (previous == &task_detached_marker) {
+        // the Task is gone, the frame is ours to free
+        handle.destroy();
+        return std::noop_coroutine();
+      }
+      if (previous) {
+        return std::coroutine_handle<>::from_address(previous);
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+  FinalAwaiter final_suspend() noexcept { return {}; }
+
+  T result() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return this->take();
+  }
+};
+} // namespace detail
+
+template <typename T> class [[nodiscard]] Task {
+public:
+  using promise_type = detail::TaskPromise<T>;
+
+  Task() = default;
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+  Task(Task &&other) noexcept
+      : handle(std::exchange(other.handle, {})), started(other.started) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      reset();
+      handle = std::exchange(other.handle, {});
+      started = other.started;
+    }
+    return *this;
+  }
+  ~Task() { reset(); }
+
+  // Runs the task on the calling thread until its first suspension.
+  void start() {
+    if (!started) {
+      started = true;
+      handle.resume();
+    }
+  }
+
+  bool done() const {
+    return handle.promise().waiter.load() == &detail::task_done_marker;
+  }
+
+  auto operator co_await() noexcept { return Awaiter<true>{*this}; }
+  // Awaits the task without taking its result.
+  auto completion() noexcept { return Awaiter<false>{*this}; }
+  // Result of a finished task, rethrows what the task threw.
+  T result() { return handle.promise().result(); }
+
+private:
+  template <bool Fetch> struct Awaiter {
+    Task &task;
+    bool await_ready() noexcept { return task.started && task.done(); }
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<> awaiting) noexcept {
+      auto &waiter = task.handle.promise().waiter;
+      if (!task.started) {
+        // symmetric transfer into the lazy task
+        task.started = true;
+        waiter.store(awaiting.address());
+        return task.handle;
+      }
+      void *expected = nullptr;
+      if (waiter.compare_exchange_strong(expected, awaiting.address())) {
+        return std::noop_coroutine();
+      }
+      // finished in the meantime
+      return awaiting;
+    }
+    auto await_resume() {
+      if constexpr (Fetch) {
+        return task.result();
+      }
+    }
+  };
+
+  // A task that is not running is destroyed here. A running one is
+  // detached and destroys itself at its final suspension. A task must not be
+  // dropped while something awaits it.
+  void reset() {
+    if (!handle) {
+      return;
+    }
+    void *expected = nullptr;
+    if (!started) {
+      handle.destroy();
+    } else if (!handle.promise().waiter.compare_exchange_strong(
+                   expected, &detail::task_detached_marker) &&
+               expected == &detail::task_done_marker) {
+      handle.destroy();
+    }
+    handle = {};
+  }
+
+  std::coroutine_handle<promise_type> handle;
+  bool started = false;
+};
+
+template <typename T> Task<T> detail::TaskPromise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+namespace detail {
+// Fire-and-forget coroutine, used to bridge a Task into a blocking wait.
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+} // namespace detail
+
+// Blocks the calling thread until the task finished and returns its result.
+template <typename T> T sync_wait(Task<T> &task) {
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool done = false;
+
+  auto notify = [](Task<T> &task, std::mutex &mutex,
+                   std::condition_variable &finished,
+                   bool &done) -> detail::Detached {
+    co_await task.completion();
+    // notified under the lock, so the waiter cannot return before we are done
+    std::lock_guard lock(mutex);
+    done = true;
+    finished.notify_all();
+  };
+  notify(task, mutex, finished, done);
+
+  std::unique_lock lock(mutex);
+  finished.wait(lock, [&] { return done; });
+  return task.result();
+}
+
+template <typename T> T sync_wait(Task<T> &&task) { return sync_wait(task); }
+
+} // namespace dfg
@@ -0,0 +1,191 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <print>
+
+namespace dfg {
+
+// worker index within current(), only meaningful on a pool thread
+static thread_local size_t current_worker = 0;
+
+size_t WorkStealingPool::default_threads() {
+  return std::max(2u, std::thread::hardware_concurrency()) - 1;
+}
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([this, i] { run(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard lock(sleep_mutex);
+    stopping = true;
+  }
+  work_available.notify_all();
+  workers.clear();
+}
+
+void WorkStealingPool::post(std::function<void()> job, Priority priority,
+                            const char *label) {
+  {
+    auto &queue = current() == this ? *queues[current_worker] : injected;
+    std::lock_guard lock(queue.mutex);
+    queue.jobs[static_cast<size_t>(priority)].push_back(
+        {std::move(job), label, std::chrono::steady_clock::now()});
+  }
+  pending.fetch_add(1);
+  // lock so a worker between its check and its wait cannot miss the notify
+  { std::lock_guard lock(sleep_mutex); }
+  work_available.notify_one();
+}
+
+bool WorkStealingPool::try_pop(size_t index, Job &job) {
+  for (size_t priority = 0; priority < 3; ++priority) {
+    {
+      auto &own = *queues[index];
+      std::lock_guard lock(own.mutex);
+      auto &jobs = own.jobs[priority];
+      if (!jobs.empty()) {
+        job = std::move(jobs.back());
+        jobs.pop_back();
+        return true;
+      }
+    }
+    {
+      std::lock_guard lock(injected.mutex);
+      auto &jobs = injected.jobs[priority];
+      if (!jobs.empty()) {
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        return true;
+      }
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+      auto &victim = *queues[(index + i) % queues.size()];
+      std::lock_guard lock(victim.mutex);
+      auto &jobs = victim.jobs[priority];
+      if (!jobs.empty()) {
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::execute(Job &job) {
+  auto start = std::chrono::steady_clock::now();
+  bool failed = false;
+  try {
+    job.fn();
+  } catch (const std::exception &e) {
+    std::println("[pool] {} job failed: {}", job.label, e.what());
+    failed = true;
+  } catch (...) {
+    std::println("[pool] {} job failed", job.label);
+    failed = true;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  using ms = std::chrono::duration<double, std::milli>;
+  double queued = ms(start - job.queued_at).count();
+  std::lock_guard lock(stats_mutex);
+  auto &stats = task_stats[job.label];
+  stats.count++;
+  stats.queued_ms += queued;
+  stats.max_queued_ms = std::max(stats.max_queued_ms, queued);
+  stats.run_ms += ms(end - start).count();
+  stats.failed += failed ? 1 : 0;
+}
+
+void WorkStealingPool::run(size_t index) {
+  current_executor = this;
+  current_worker = index;
+  while (true) {
+    Job job;
+    if (try_pop(index, job)) {
+      pending.fetch_sub(1);
+      execute(job);
+      continue;
+    }
+    std::unique_lock lock(sleep_mutex);
+    work_available.wait(lock,
+                        [this] { return stopping || pending.load() > 0; });
+    if (stopping && pending.load() == 0) {
+      return;
+    }
+  }
+}
+
+void WorkStealingPool::parallel_for(size_t count,
+                                    const std::function<void(size_t)> &fn,
+                                    Priority priority, const char *label) {
+  if (count == 0) {
+    return;
+  }
+  // shared, helpers may only get to run after the caller returned
+  struct State {
+    std::function<void(size_t)> fn;
+    size_t count;
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> finished = 0;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+  };
+  auto state = std::make_shared<State>();
+  state->fn = fn;
+  state->count = count;
+
+  auto work = [state] {
+    for (size_t i; (i = state->next.fetch_add(1)) < state->count;) {
+      try {
+        state->fn(i);
+      } catch (...) {
+        std::lock_guard lock(state->error_mutex);
+        if (!state->error) {
+          state->error = std::current_exception();
+        }
+      }
+      if (state->finished.fetch_add(1) + 1 == state->count) {
+        state->finished.notify_all();
+      }
+    }
+  };
+  size_t helpers = std::min(count - 1, workers.size());
+  for (size_t i = 0; i < helpers; ++i) {
+    post(work, priority, label);
+  }
+  work();
+
+  for (size_t done; (done = state->finished.load()) < count;) {
+    state->finished.wait(done);
+  }
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+std::map<std::string, WorkStealingPool::TaskStats> WorkStealingPool::stats() {
+  std::lock_guard lock(stats_mutex);
+  return task_stats;
+}
+
+void WorkStealingPool::log_stats() {
+  for (const auto &[label, stats] : this->stats()) {
+    std::println("[pool] {}: {} tasks ({} failed), queued avg {:.2f} ms "
+                 "(max {:.2f}), run avg {:.2f} ms",
+                 label, stats.count, stats.failed,
+                 stats.queued_ms / stats.count, stats.max_queued_ms,
+                 stats.run_ms / stats.count);
+  }
+}
+
+} // namespace dfg
@@ -0,0 +1,124 @@
+#pragma once
+#include "executor.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dfg {
+
+// Higher priorities are always taken first, from any worker's queue.
+enum class Priority { Interactive, Normal, Background };
+
+// The one pool every vision subsystem runs on. Each worker owns a queue per
+// priority: jobs posted from a worker go to its own queue and are taken back
+// newest first, while idle workers steal the oldest jobs of the others. Jobs
+// posted from other threads go to a shared injection queue and run in the
+// order they were posted.
+class WorkStealingPool : public Executor {
+public:
+  explicit WorkStealingPool(size_t threads = default_threads());
+  ~WorkStealingPool();
+  // One thread per core, less the one driving the UI.
+  static size_t default_threads();
+
+  void post(std::function<void()> job) override {
+    post(std::move(job), Priority::Normal);
+  }
+  // label groups the job in stats() and must outlive the pool, e.g. a literal.
+  // Nobody waits for a posted job, so what it throws is logged and counted in
+  // stats() instead of ending the process; use submit to get the exception.
+  void post(std::function<void()> job, Priority priority,
+            const char *label = "task");
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F fn, Priority priority,
+                                              const char *label) {
+    auto task =
+        std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(
+            std::move(fn));
+    auto future = task->get_future();
+    post([task] { (*task)(); }, priority, label);
+    return future;
+  }
+
+  // Runs fn(i) for every i in [0, count) and returns when all are done. The
+  // calling thread takes a share, so this is safe to call from a worker. The
+  // first exception thrown by fn is rethrown here.
+  void parallel_for(size_t count, const std::function<void(size_t)> &fn,
+                    Priority priority = Priority::Normal,
+                    const char *label = "parallel_for");
+
+  struct TaskStats {
+    size_t count = 0;
+    // from post to start
+    double queued_ms = 0;
+    double max_queued_ms = 0;
+    double run_ms = 0;
+    // jobs that ended with an exception
+    size_t failed = 0;
+  };
+  std::map<std::string, TaskStats> stats();
+  void log_stats();
+
+  size_t size() const { return workers.size(); }
+
+private:
+  struct Job {
+    std::function<void()> fn;
+    const char *label;
+    std::chrono::steady_clock::time_point queued_at;
+  };
+  struct Queue {
+    std::mutex mutex;
+    std::array<std::deque<Job>, 3> jobs;
+  };
+
+  bool try_pop(size_t index, Job &job);
+  void run(size_t index);
+  void execute(Job &job);
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  // posts from outside the pool, taken oldest first
+  Queue injected;
+  std::atomic<size_t> pending = 0;
+
+  std::mutex sleep_mutex;
+  std::condition_variable work_available;
+  bool stopping = false;
+
+  std::mutex stats_mutex;
+  std::map<std::string, TaskStats> task_stats;
+
+  std::vector<std::jthread> workers;
+};
+
+// co_await schedule_on(pool, priority) continues the coroutine on the pool.
+inline auto schedule_on(WorkStealingPool &pool, Priority priority,
+                        const char *label = "coroutine") {
+  struct Awaiter {
+    WorkStealingPool &pool;
+    Priority priority;
+    const char *label;
+    bool await_ready() const noexcept { return Executor::current() == &pool; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      pool.post([handle] { handle.resume(); }, priority, label);
+    }
+    void await_resume() const noexcept {}
+  };
+  return Awaiter{pool, priority, label};
+}
+
+} // namespace dfg
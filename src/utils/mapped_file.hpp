@@ -0,0 +1,174 @@
+#pragma once
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dfg {
+// View of a whole file. Pages are served from the system file cache on first
+// touch instead of being read into a private buffer up front.
+class MappedFile {
+public:
+  enum class Mode { ReadOnly, ReadWrite };
+
+  MappedFile() = default;
+  // In ReadWrite mode the file is created if missing and grown to at least
+  // min_size bytes, new bytes read as zero.
+  explicit MappedFile(const std::filesystem::path &path,
+                      Mode mode = Mode::ReadOnly, size_t min_size = 0) {
+    bool writable = mode == Mode::ReadWrite;
+#ifdef _WIN32
+    file = CreateFileW(path.c_str(),
+                       writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                       FILE_SHARE_READ, nullptr,
+                       writable ? OPEN_ALWAYS : OPEN_EXISTING,
+                       writable ? FILE_ATTRIBUTE_NORMAL
+                                : FILE_FLAG_SEQUENTIAL_SCAN,
+                       nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      throw std::runtime_error("Failed to open file: " + path.string());
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+      close();
+      throw std::runtime_error("Failed to get file size: " + path.string());
+    }
+    length = std::max(static_cast<size_t>(file_size.QuadPart),
+                      writable ? min_size : 0);
+    if (length == 0) {
+      return;
+    }
+
+    LARGE_INTEGER map_size;
+    map_size.QuadPart = static_cast<LONGLONG>(length);
+    // a writable mapping larger than the file extends it
+    mapping = CreateFileMappingW(file, nullptr,
+                                 writable ? PAGE_READWRITE : PAGE_READONLY,
+                                 map_size.HighPart, map_size.LowPart, nullptr);
+    if (mapping) {
+      view = MapViewOfFile(mapping,
+                           writable ? FILE_MAP_READ | FILE_MAP_WRITE
+                                    : FILE_MAP_READ,
+                           0, 0, 0);
+    }
+#else
+    file = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (file < 0) {
+      throw std::runtime_error("Failed to open file: " + path.string());
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0) {
+      close();
+      throw std::runtime_error("Failed to get file size: " + path.string());
+    }
+    length = std::max(static_cast<size_t>(file_stat.st_size),
+                      writable ? min_size : 0);
+    if (length == 0) {
+      return;
+    }
+
+    // unlike a Windows mapping, mmap does not extend the file
+    if (writable && static_cast<size_t>(file_stat.st_size) < length &&
+        ftruncate(file, static_cast<off_t>(length)) != 0) {
+      close();
+      throw std::runtime_error("Failed to extend file: " + path.string());
+    }
+    view = mmap(nullptr, length, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                MAP_SHARED, file, 0);
+    if (view == MAP_FAILED) {
+      view = nullptr;
+    }
+#endif
+    if (!view) {
+      close();
+      throw std::runtime_error("Failed to map file: " + path.string());
+    }
+  }
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      file = std::exchange(other.file, invalid_file);
+#ifdef _WIN32
+      mapping = std::exchange(other.mapping, nullptr);
+#endif
+      view = std::exchange(other.view, nullptr);
+      length = std::exchange(other.length, 0);
+    }
+    return *this;
+  }
+
+  const char *data() const { return static_cast<const char *>(view); }
+  // Only valid for ReadWrite mappings.
+  char *mutable_data() { return static_cast<char *>(view); }
+  size_t size() const { return length; }
+  bool is_open() const { return file != invalid_file; }
+
+  // Write dirty pages back to the file.
+  void flush() {
+    if (view) {
+#ifdef _WIN32
+      FlushViewOfFile(view, 0);
+#else
+      msync(view, length, MS_SYNC);
+#endif
+    }
+  }
+
+  void close() {
+#ifdef _WIN32
+    if (view) {
+      UnmapViewOfFile(view);
+      view = nullptr;
+    }
+    if (mapping) {
+      CloseHandle(mapping);
+      mapping = nullptr;
+    }
+    if (file != invalid_file) {
+      CloseHandle(file);
+      file = invalid_file;
+    }
+#else
+    if (view) {
+      munmap(view, length);
+      view = nullptr;
+    }
+    if (file != invalid_file) {
+      ::close(file);
+      file = invalid_file;
+    }
+#endif
+    length = 0;
+  }
+
+private:
+#ifdef _WIN32
+  using Handle = HANDLE;
+  static inline const Handle invalid_file = INVALID_HANDLE_VALUE;
+  Handle mapping = nullptr;
+#else
+  using Handle = int;
+  static constexpr Handle invalid_file = -1;
+#endif
+  Handle file = invalid_file;
+  void *view = nullptr;
+  size_t length = 0;
+};
+} // namespace dfg
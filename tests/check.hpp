@@ -0,0 +1,37 @@
+#pragma once
+#include <print>
+#include <vector>
+
+// A minimal test registry: TEST_CASE defines a case, CHECK records a failure
+// and keeps going, tests/main.cc runs every case.
+namespace dfg::test {
+struct Case {
+  const char *name;
+  void (*fn)();
+};
+
+inline std::vector<Case> &cases() {
+  static std::vector<Case> registered;
+  return registered;
+}
+
+inline int failures = 0;
+
+struct Register {
+  Register(const char *name, void (*fn)()) { cases().push_back({name, fn}); }
+};
+} // namespace dfg::test
+
+#define TEST_CASE(name)                                                        \
+  static void name();                                                          \
+  static dfg::test::Register name##_registered(#name, name);                   \
+  static void name()
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::println("  {}:{}: CHECK({}) failed", __FILE__, __LINE__,            \
+                   #condition);                                                \
+      dfg::test::failures++;                                                   \
+    }                                                                          \
+  } while (0)
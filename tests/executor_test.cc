@@ -0,0 +1,85 @@
+#include "check.hpp"
+
+#include "runtime/executor.h"
+#include "runtime/task.hpp"
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <vector>
+
+using dfg::Executor;
+using dfg::Task;
+using dfg::ThreadPool;
+using dfg::TimerQueue;
+
+namespace {
+Task<Executor *> resumed_on(ThreadPool &pool) {
+  co_await dfg::schedule_on(pool);
+  co_return Executor::current();
+}
+
+// sleeps on the pool and reports how long it took and where it continued
+Task<std::pair<std::chrono::milliseconds, Executor *>>
+sleep_on(ThreadPool &pool, TimerQueue &timers,
+         std::chrono::milliseconds duration) {
+  co_await dfg::schedule_on(pool);
+  auto start = std::chrono::steady_clock::now();
+  co_await dfg::sleep_for(timers, duration);
+  co_return std::pair{
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start),
+      Executor::current()};
+}
+} // namespace
+
+TEST_CASE(thread_pool_single_thread_keeps_order) {
+  ThreadPool input(1);
+  std::mutex mutex;
+  std::vector<int> order;
+  std::promise<void> finished;
+  for (int i = 0; i < 100; ++i) {
+    input.post([&, i] {
+      std::lock_guard lock(mutex);
+      order.push_back(i);
+      if (i == 99) {
+        finished.set_value();
+      }
+    });
+  }
+  finished.get_future().wait();
+  bool in_order = order.size() == 100;
+  for (int i = 0; i < static_cast<int>(order.size()); ++i) {
+    in_order = in_order && order[i] == i;
+  }
+  CHECK(in_order);
+}
+
+TEST_CASE(schedule_on_continues_on_executor) {
+  ThreadPool pool(2);
+  CHECK(sync_wait(resumed_on(pool)) == &pool);
+}
+
+TEST_CASE(sleep_for_resumes_on_calling_executor) {
+  ThreadPool pool(1);
+  TimerQueue timers;
+  auto [slept, executor] =
+      sync_wait(sleep_on(pool, timers, std::chrono::milliseconds(30)));
+  CHECK(slept >= std::chrono::milliseconds(30));
+  CHECK(executor == &pool);
+}
+
+TEST_CASE(sleep_for_orders_timers_by_deadline) {
+  ThreadPool pool(2);
+  TimerQueue timers;
+  // the longer sleep is scheduled first, the shorter one still ends first
+  auto late = sleep_on(pool, timers, std::chrono::milliseconds(60));
+  auto early = sleep_on(pool, timers, std::chrono::milliseconds(10));
+  late.start();
+  early.start();
+  auto started = std::chrono::steady_clock::now();
+  sync_wait(early);
+  auto early_done = std::chrono::steady_clock::now() - started;
+  sync_wait(late);
+  CHECK(early_done < std::chrono::milliseconds(50));
+}
@@ -0,0 +1,70 @@
+#include "check.hpp"
+
+#include "automation/frame_buffer_pool.h"
+
+using dfg::FrameBufferPool;
+
+TEST_CASE(buffer_pool_reuses_released_buffer) {
+  FrameBufferPool pool;
+  auto first = pool.acquire(cv::Size(64, 32), CV_8UC4);
+  auto data = first.data;
+  first.release();
+
+  auto second = pool.acquire(cv::Size(64, 32), CV_8UC4);
+  CHECK(second.data == data);
+  auto stats = pool.stats();
+  CHECK(stats.allocations == 1);
+  CHECK(stats.allocated_bytes == 64 * 32 * 4);
+  CHECK(stats.reuses == 1);
+  CHECK(stats.buffers == 1);
+}
+
+TEST_CASE(buffer_pool_never_shares_buffer_in_use) {
+  FrameBufferPool pool;
+  auto first = pool.acquire(cv::Size(16, 16), CV_8UC1);
+  auto copy_of_first = first;
+  first.release();
+
+  // copy_of_first still holds the pixels
+  auto second = pool.acquire(cv::Size(16, 16), CV_8UC1);
+  CHECK(second.data != copy_of_first.data);
+  CHECK(pool.stats().allocations == 2);
+  CHECK(pool.stats().reuses == 0);
+}
+
+TEST_CASE(buffer_pool_matches_size_and_type) {
+  FrameBufferPool pool;
+  pool.acquire(cv::Size(16, 16), CV_8UC1);
+  auto other_type = pool.acquire(cv::Size(16, 16), CV_8UC4);
+  auto other_size = pool.acquire(cv::Size(16, 8), CV_8UC1);
+  CHECK(other_type.type() == CV_8UC4);
+  CHECK(other_size.size() == cv::Size(16, 8));
+  CHECK(pool.stats().allocations == 3);
+  CHECK(pool.stats().reuses == 0);
+}
+
+TEST_CASE(buffer_pool_replaces_free_buffer_when_full) {
+  FrameBufferPool pool(1);
+  pool.acquire(cv::Size(8, 8), CV_8UC1);
+  // the kept 8x8 buffer is free, so it makes room for the new shape
+  auto held = pool.acquire(cv::Size(4, 4), CV_8UC1);
+  // the kept 4x4 buffer is in use and cannot be replaced
+  pool.acquire(cv::Size(2, 2), CV_8UC1);
+
+  auto stats = pool.stats();
+  CHECK(stats.allocations == 3);
+  CHECK(stats.buffers == 1);
+  held.release();
+  pool.acquire(cv::Size(4, 4), CV_8UC1);
+  CHECK(pool.stats().reuses == 1);
+}
+
+TEST_CASE(buffer_pool_copy_is_continuous) {
+  FrameBufferPool pool;
+  cv::Mat image(8, 8, CV_8UC1, cv::Scalar(7));
+  auto crop = image(cv::Rect(2, 2, 4, 4));
+  auto copy = pool.copy(crop);
+  CHECK(copy.isContinuous());
+  CHECK(copy.size() == crop.size());
+  CHECK(cv::countNonZero(copy != 7) == 0);
+}
@@ -0,0 +1,114 @@
+#include "check.hpp"
+
+#include "automation/gray_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+using dfg::bgra_to_gray;
+using dfg::GrayPlane;
+
+namespace {
+
+struct Image {
+  int width = 0, height = 0, channels = 1;
+  std::vector<uint8_t> pixels;
+
+  Image(int width, int height, int channels)
+      : width(width), height(height), channels(channels),
+        pixels(static_cast<size_t>(width) * height * channels) {}
+  uint8_t *data() { return pixels.data(); }
+  size_t step() const { return static_cast<size_t>(width) * channels; }
+  uint8_t at(int x, int y, int c = 0) const {
+    return pixels[y * step() + x * channels + c];
+  }
+  GrayPlane plane() {
+    return GrayPlane{data(), step(), width, height};
+  }
+};
+
+Image noise(int width, int height) {
+  Image image(width, height, 4);
+  uint32_t state = 12345;
+  for (auto &p : image.pixels) {
+    state = state * 1664525 + 1013904223;
+    p = static_cast<uint8_t>(state >> 24);
+  }
+  return image;
+}
+
+// what cv::resize with INTER_LINEAR followed by cv::COLOR_BGRA2GRAY gives,
+// in floating point
+Image reference_gray(const Image &bgra, int width, int height) {
+  Image gray(width, height, 1);
+  auto taps = [](int dst, int src_size, int dst_size, int &i0, int &i1,
+                 double &w) {
+    double f = (dst + 0.5) * src_size / dst_size - 0.5;
+    i0 = static_cast<int>(std::floor(f));
+    w = f - i0;
+    if (i0 < 0) {
+      i0 = 0;
+      w = 0;
+    }
+    i1 = std::min(i0 + 1, src_size - 1);
+  };
+  for (int y = 0; y < height; ++y) {
+    int y0, y1;
+    double wy;
+    taps(y, bgra.height, height, y0, y1, wy);
+    for (int x = 0; x < width; ++x) {
+      int x0, x1;
+      double wx;
+      taps(x, bgra.width, width, x0, x1, wx);
+      double channel[3];
+      for (int c = 0; c < 3; ++c) {
+        double top = bgra.at(x0, y0, c) * (1 - wx) + bgra.at(x1, y0, c) * wx;
+        double bottom =
+            bgra.at(x0, y1, c) * (1 - wx) + bgra.at(x1, y1, c) * wx;
+        channel[c] = top * (1 - wy) + bottom * wy;
+      }
+      double value =
+          0.114 * channel[0] + 0.587 * channel[1] + 0.299 * channel[2];
+      gray.pixels[y * gray.step() + x] =
+          static_cast<uint8_t>(std::lround(value));
+    }
+  }
+  return gray;
+}
+
+int max_difference(const Image &a, const Image &b) {
+  int worst = 0;
+  for (int y = 0; y < a.height; ++y) {
+    for (int x = 0; x < a.width; ++x) {
+      worst = std::max(worst, std::abs(a.at(x, y) - b.at(x, y)));
+    }
+  }
+  return worst;
+}
+
+} // namespace
+
+TEST_CASE(gray_conversion_native_size_matches_reference) {
+  auto bgra = noise(37, 23);
+  Image gray(37, 23, 1);
+  bgra_to_gray(bgra.data(), bgra.step(), bgra.width, bgra.height, gray.plane());
+  CHECK(max_difference(gray, reference_gray(bgra, 37, 23)) <= 1);
+}
+
+TEST_CASE(gray_conversion_downscale_matches_reference) {
+  auto bgra = noise(64, 48);
+  Image gray(45, 34, 1);
+  bgra_to_gray(bgra.data(), bgra.step(), bgra.width, bgra.height, gray.plane());
+  // resampling gray instead of color and the 8-bit weights cost a little
+  CHECK(max_difference(gray, reference_gray(bgra, 45, 34)) <= 2);
+}
+
+TEST_CASE(gray_conversion_upscale_matches_reference) {
+  auto bgra = noise(30, 20);
+  Image gray(47, 31, 1);
+  bgra_to_gray(bgra.data(), bgra.step(), bgra.width, bgra.height, gray.plane());
+  CHECK(max_difference(gray, reference_gray(bgra, 47, 31)) <= 2);
+}
@@ -0,0 +1,22 @@
+#include "check.hpp"
+
+#include <exception>
+
+int main() {
+  int failed_cases = 0;
+  for (const auto &test_case : dfg::test::cases()) {
+    int before = dfg::test::failures;
+    try {
+      test_case.fn();
+    } catch (const std::exception &e) {
+      std::println("  threw: {}", e.what());
+      dfg::test::failures++;
+    }
+    bool passed = dfg::test::failures == before;
+    failed_cases += passed ? 0 : 1;
+    std::println("[{}] {}", passed ? "pass" : "FAIL", test_case.name);
+  }
+  std::println("{} of {} test cases failed", failed_cases,
+               dfg::test::cases().size());
+  return failed_cases == 0 ? 0 : 1;
+}
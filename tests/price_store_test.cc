@@ -0,0 +1,108 @@
+#include "check.hpp"
+
+#include "behaviors/price_store.h"
+
+#include <chrono>
+#include <filesystem>
+
+using dfg::PriceStore;
+
+namespace {
+
+// A store file of its own, removed again when the test is done.
+struct TempStore {
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "dfg_price_store_test";
+  std::filesystem::path path = dir / "prices.bin";
+
+  TempStore() { std::filesystem::remove_all(dir); }
+  ~TempStore() { std::filesystem::remove_all(dir); }
+};
+
+PriceStore::Observation observation(int price, int quality) {
+  return PriceStore::Observation{price, price * 2, true, 1000, quality};
+}
+
+} // namespace
+
+TEST_CASE(price_store_lookup_requires_same_quality) {
+  TempStore temp;
+  PriceStore store(temp.path);
+  store.open();
+  store.record(42, observation(100, 3));
+
+  auto found = store.lookup(42, 3);
+  CHECK(found.has_value());
+  CHECK(found && found->price_system_buy == 100);
+  CHECK(found && found->price_market == 200);
+  CHECK(found && found->can_sell_in_market);
+  CHECK(!store.lookup(42, 4).has_value());
+  CHECK(!store.lookup(43, 3).has_value());
+}
+
+TEST_CASE(price_store_record_replaces_observation) {
+  TempStore temp;
+  PriceStore store(temp.path);
+  store.open();
+  store.record(7, observation(100, 2));
+  store.record(7, observation(150, 5));
+
+  CHECK(store.size() == 1);
+  CHECK(!store.lookup(7, 2).has_value());
+  auto found = store.lookup(7, 5);
+  CHECK(found && found->price_system_buy == 150);
+}
+
+TEST_CASE(price_store_persists_across_reopen) {
+  TempStore temp;
+  {
+    PriceStore store(temp.path);
+    store.open();
+    store.record(1, observation(10, 1));
+    store.record(2, observation(20, 2));
+    store.flush();
+  }
+
+  PriceStore store(temp.path);
+  store.open();
+  CHECK(store.size() == 2);
+  auto found = store.lookup(2, 2);
+  CHECK(found && found->price_system_buy == 20 && found->observed_at == 1000);
+}
+
+TEST_CASE(price_store_grows_past_initial_capacity) {
+  TempStore temp;
+  PriceStore store(temp.path);
+  store.open();
+  constexpr int items = 3000;
+  for (int i = 0; i < items; ++i) {
+    store.record(0x9e3779b97f4a7c15ull * (i + 1), observation(i, i % 7));
+  }
+
+  CHECK(store.size() == items);
+  bool all_found = true;
+  for (int i = 0; i < items; ++i) {
+    auto found = store.lookup(0x9e3779b97f4a7c15ull * (i + 1), i % 7);
+    all_found = all_found && found && found->price_system_buy == i;
+  }
+  CHECK(all_found);
+  // the grown table replaced the store, no temporary file is left behind
+  CHECK(!std::filesystem::exists(temp.dir / "prices.bin.grow"));
+
+  store.flush();
+  PriceStore reopened(temp.path);
+  reopened.open();
+  CHECK(reopened.size() == items);
+}
+
+TEST_CASE(price_store_freshness) {
+  TempStore temp;
+  PriceStore store(temp.path);
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+  auto recent = observation(1, 1);
+  recent.observed_at = now - 60;
+  CHECK(store.is_fresh(recent, std::chrono::minutes(5)));
+  CHECK(!store.is_fresh(recent, std::chrono::seconds(30)));
+}
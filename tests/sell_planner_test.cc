@@ -0,0 +1,81 @@
+#include "check.hpp"
+
+#include "behaviors/sell_planner.h"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+using dfg::SellPlanner;
+
+namespace {
+
+SellPlanner planner() {
+  SellPlanner planner;
+  planner.page_rows = 10;
+  planner.max_top_row = 30;
+  planner.cell_size = cv::Size(80, 80);
+  return planner;
+}
+
+std::vector<size_t> planned_items(const SellPlanner::Plan &plan) {
+  std::vector<size_t> items;
+  for (const auto &group : plan.groups) {
+    items.insert(items.end(), group.items.begin(), group.items.end());
+  }
+  std::sort(items.begin(), items.end());
+  return items;
+}
+
+auto rank(const SellPlanner::Cost &cost) {
+  return std::make_tuple(cost.scroll_rows, cost.direction_changes,
+                         cost.travel);
+}
+
+} // namespace
+
+TEST_CASE(sell_planner_empty_plan) {
+  auto plan = planner().plan({}, 0);
+  CHECK(plan.groups.empty());
+  CHECK(plan.cost.scroll_rows == 0);
+  CHECK(plan.cost.travel == 0);
+}
+
+TEST_CASE(sell_planner_visible_page_needs_no_scroll) {
+  std::vector<cv::Point> cells{{0, 0}, {8, 9}, {4, 5}, {1, 1}};
+  auto plan = planner().plan(cells, 0);
+  CHECK(plan.groups.size() == 1);
+  CHECK(plan.groups.front().top_row == 0);
+  CHECK(plan.cost.scroll_rows == 0);
+  CHECK(plan.cost.direction_changes == 0);
+}
+
+TEST_CASE(sell_planner_plans_every_item_once) {
+  std::vector<cv::Point> cells{{0, 2}, {3, 35}, {5, 14}, {1, 28},
+                               {7, 3}, {2, 22}, {8, 39}, {4, 14}};
+  auto plan = planner().plan(cells, 0);
+  CHECK(planned_items(plan) == (std::vector<size_t>{0, 1, 2, 3, 4, 5, 6, 7}));
+}
+
+TEST_CASE(sell_planner_items_are_on_their_page) {
+  auto sell_planner = planner();
+  std::vector<cv::Point> cells{{0, 2}, {3, 35}, {5, 14}, {1, 28}, {7, 3}};
+  auto plan = sell_planner.plan(cells, 12);
+  for (const auto &group : plan.groups) {
+    CHECK(group.top_row >= 0 && group.top_row <= sell_planner.max_top_row);
+    for (auto index : group.items) {
+      CHECK(cells[index].y >= group.top_row &&
+            cells[index].y < group.top_row + sell_planner.page_rows);
+    }
+  }
+}
+
+TEST_CASE(sell_planner_beats_alternating_order) {
+  // back and forth between the top and the bottom of the list
+  std::vector<cv::Point> cells{{0, 0},  {0, 38}, {1, 2},
+                               {1, 36}, {2, 4},  {2, 34}};
+  auto plan = planner().plan(cells, 0);
+  CHECK(rank(plan.cost) <= rank(plan.naive_cost));
+  CHECK(plan.cost.scroll_rows < plan.naive_cost.scroll_rows);
+  CHECK(plan.cost.direction_changes == 0);
+}
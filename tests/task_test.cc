@@ -0,0 +1,96 @@
+#include "check.hpp"
+
+#include "runtime/task.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using dfg::Task;
+
+namespace {
+std::atomic<int> live_frames = 0;
+
+// counts coroutine frames that have not been destroyed yet
+struct FrameCounter {
+  FrameCounter() { live_frames++; }
+  ~FrameCounter() { live_frames--; }
+};
+
+// suspends and hands the coroutine to the test, which resumes it at will
+struct Park {
+  std::coroutine_handle<> &parked;
+  bool await_ready() noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle) noexcept {
+    parked = handle;
+  }
+  void await_resume() noexcept {}
+};
+
+Task<int> parked_value(std::coroutine_handle<> &parked, int value) {
+  FrameCounter counter;
+  co_await Park{parked};
+  co_return value;
+}
+
+Task<int> add(Task<int> a, Task<int> b) { co_return co_await a + co_await b; }
+
+Task<int> immediate(int value) { co_return value; }
+
+Task<int> failing() {
+  throw std::runtime_error("failed");
+  co_return 0;
+}
+} // namespace
+
+TEST_CASE(task_is_lazy_and_awaitable) {
+  CHECK(sync_wait(add(immediate(2), immediate(3))) == 5);
+}
+
+TEST_CASE(task_sync_wait_waits_for_other_thread) {
+  std::coroutine_handle<> parked;
+  auto task = parked_value(parked, 7);
+  task.start();
+  CHECK(!task.done());
+  std::jthread resumer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    parked.resume();
+  });
+  CHECK(sync_wait(task) == 7);
+}
+
+TEST_CASE(task_rethrows_exceptions) {
+  bool threw = false;
+  try {
+    sync_wait(failing());
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+TEST_CASE(task_dropped_while_running_frees_itself) {
+  std::coroutine_handle<> parked;
+  {
+    auto task = parked_value(parked, 1);
+    task.start();
+  }
+  // detached, the frame lives until the coroutine finishes
+  CHECK(live_frames == 1);
+  std::jthread([&] { parked.resume(); }).join();
+  CHECK(live_frames == 0);
+}
+
+TEST_CASE(task_dropped_before_start_or_after_finish) {
+  std::coroutine_handle<> parked;
+  { auto task = parked_value(parked, 1); }
+  CHECK(live_frames == 0);
+  {
+    auto task = parked_value(parked, 1);
+    task.start();
+    parked.resume();
+    CHECK(task.done());
+  }
+  CHECK(live_frames == 0);
+}
@@ -0,0 +1,135 @@
+#include "check.hpp"
+
+#include "runtime/thread_pool.h"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using dfg::Priority;
+using dfg::WorkStealingPool;
+
+TEST_CASE(pool_parallel_for_visits_every_index_once) {
+  WorkStealingPool pool(4);
+  std::vector<std::atomic<int>> visits(1000);
+  pool.parallel_for(visits.size(), [&](size_t i) { visits[i]++; });
+  bool once = true;
+  for (auto &count : visits) {
+    once = once && count == 1;
+  }
+  CHECK(once);
+}
+
+TEST_CASE(pool_parallel_for_nested_in_worker) {
+  WorkStealingPool pool(2);
+  std::atomic<int> sum = 0;
+  auto outer = pool.submit(
+      [&] {
+        pool.parallel_for(100, [&](size_t i) { sum += static_cast<int>(i); });
+      },
+      Priority::Normal, "outer");
+  outer.get();
+  CHECK(sum == 4950);
+}
+
+TEST_CASE(pool_submit_forwards_result_and_exception) {
+  WorkStealingPool pool(2);
+  auto value = pool.submit([] { return 42; }, Priority::Interactive, "value");
+  CHECK(value.get() == 42);
+
+  auto failing = pool.submit([]() -> int { throw std::runtime_error("no"); },
+                             Priority::Normal, "failing");
+  bool threw = false;
+  try {
+    failing.get();
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+TEST_CASE(pool_parallel_for_rethrows) {
+  WorkStealingPool pool(3);
+  std::atomic<int> ran = 0;
+  bool threw = false;
+  try {
+    pool.parallel_for(50, [&](size_t i) {
+      ran++;
+      if (i == 10) {
+        throw std::runtime_error("index 10");
+      }
+    });
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+  // the other indices still ran
+  CHECK(ran == 50);
+}
+
+TEST_CASE(pool_posted_job_failure_is_counted) {
+  std::atomic<bool> after = false;
+  {
+    WorkStealingPool pool(1);
+    pool.post([] { throw std::runtime_error("posted"); }, Priority::Normal,
+              "posted");
+    pool.submit([&] { after = true; }, Priority::Background, "after").get();
+    CHECK(pool.stats()["posted"].failed == 1);
+  }
+  // the worker survived the exception
+  CHECK(after);
+}
+
+TEST_CASE(pool_runs_higher_priority_first) {
+  WorkStealingPool pool(1);
+  std::vector<int> order;
+  std::mutex order_mutex;
+  // keep the single worker busy while the queue fills up
+  std::atomic<bool> release = false;
+  pool.post([&] { release.wait(false); }, Priority::Interactive, "block");
+  auto record = [&](int value) {
+    return [&, value] {
+      std::lock_guard lock(order_mutex);
+      order.push_back(value);
+    };
+  };
+  auto background = pool.submit(record(3), Priority::Background, "order");
+  auto normal = pool.submit(record(2), Priority::Normal, "order");
+  auto interactive = pool.submit(record(1), Priority::Interactive, "order");
+  release = true;
+  release.notify_all();
+  background.get();
+  normal.get();
+  interactive.get();
+  CHECK((order == std::vector<int>{1, 2, 3}));
+}
+
+TEST_CASE(pool_runs_external_posts_in_order) {
+  WorkStealingPool pool(1);
+  std::vector<int> order;
+  std::mutex order_mutex;
+  // hold the worker until every job is queued
+  std::atomic<bool> release = false;
+  pool.post([&] { release.wait(false); }, Priority::Normal, "block");
+  std::vector<std::future<void>> done;
+  for (int i = 0; i < 100; ++i) {
+    done.push_back(pool.submit(
+        [&, i] {
+          std::lock_guard lock(order_mutex);
+          order.push_back(i);
+        },
+        Priority::Normal, "order"));
+  }
+  release = true;
+  release.notify_all();
+  for (auto &future : done) {
+    future.get();
+  }
+  bool in_order = order.size() == 100;
+  for (int i = 0; i < static_cast<int>(order.size()); ++i) {
+    in_order = in_order && order[i] == i;
+  }
+  CHECK(in_order);
+}
@@ -0,0 +1,93 @@
+#include "check.hpp"
+
+#include "automation/window_geometry.h"
+
+#include <stdexcept>
+
+namespace {
+// A window that only moves when the test says so.
+class FakeGeometryProvider : public dfg::WindowGeometryProvider {
+public:
+  explicit FakeGeometryProvider(dfg::WindowRect rect) : rect(rect) {}
+
+  std::optional<dfg::WindowRect> query() override {
+    queries++;
+    return rect;
+  }
+  uint64_t generation() override { return current_generation; }
+
+  void move_to(dfg::WindowRect next) {
+    rect = next;
+    current_generation++;
+  }
+
+  std::optional<dfg::WindowRect> rect;
+  uint64_t current_generation = 0;
+  int queries = 0;
+};
+
+struct Fixture {
+  dfg::WindowGeometry geometry{{1920, 1080}};
+  FakeGeometryProvider *window;
+
+  explicit Fixture(dfg::WindowRect rect) {
+    auto provider = std::make_unique<FakeGeometryProvider>(rect);
+    window = provider.get();
+    geometry.attach(std::move(provider));
+  }
+};
+} // namespace
+
+TEST_CASE(window_geometry_identity_at_develop_size) {
+  Fixture f({0, 0, 1920, 1080});
+  CHECK(f.geometry.scale() == 1);
+  CHECK(f.geometry.to_screen({100, 200}) == cv::Point(100, 200));
+  CHECK(f.geometry.to_logical({100, 200}) == cv::Point(100, 200));
+}
+
+TEST_CASE(window_geometry_offset_and_scale) {
+  // half the develop size, client area at (100, 50)
+  Fixture f({100, 50, 960, 540});
+  CHECK(f.geometry.scale() == 2);
+  CHECK(f.geometry.to_screen({0, 0}) == cv::Point(100, 50));
+  CHECK(f.geometry.to_screen({1920, 1080}) == cv::Point(1060, 590));
+  CHECK(f.geometry.to_logical({1060, 590}) == cv::Point(1920, 1080));
+}
+
+TEST_CASE(window_geometry_scales_axes_separately) {
+  Fixture f({0, 0, 1920, 540});
+  auto scales = f.geometry.scales();
+  CHECK(scales.x == 1);
+  CHECK(scales.y == 2);
+  CHECK(f.geometry.to_screen({960, 1080}) == cv::Point(960, 540));
+}
+
+TEST_CASE(window_geometry_refreshes_only_on_new_generation) {
+  Fixture f({0, 0, 1920, 1080});
+  f.geometry.rect();
+  f.geometry.scale();
+  f.geometry.to_screen({1, 1});
+  CHECK(f.geometry.refreshes() == 1);
+  CHECK(f.window->queries == 1);
+
+  f.window->move_to({10, 20, 960, 540});
+  CHECK(f.geometry.to_screen({0, 0}) == cv::Point(10, 20));
+  CHECK(f.geometry.refreshes() == 2);
+
+  f.geometry.invalidate();
+  f.geometry.rect();
+  CHECK(f.geometry.refreshes() == 3);
+}
+
+TEST_CASE(window_geometry_throws_without_window) {
+  Fixture f({0, 0, 1920, 1080});
+  f.window->rect.reset();
+  f.window->current_generation++;
+  bool threw = false;
+  try {
+    f.geometry.scale();
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
@@ -15,7 +15,24 @@ target("df-green-toolkit")
     set_encodings("utf-8")
     add_packages("opencv", "cpptrace", "tesseract")
     add_files("src/*.cc", "src/*/**.cc")
-    add_links("user32", "gdi32", "windowsapp")
+    add_links("user32", "gdi32", "psapi", "dwmapi", "windowsapp")
     after_build(function (target)
         os.cp("resources/*", target:targetdir())
-    end)
\ No newline at end of file
+    end)
+
+-- Unit tests for the logic that does not need the game, run with `xmake test`.
+target("tests")
+    set_kind("binary")
+    set_default(false)
+    add_defines("NOMINMAX")
+    set_encodings("utf-8")
+    add_packages("opencv")
+    add_includedirs("src")
+    add_files("tests/*.cc")
+    add_files("src/automation/frame_buffer_pool.cc")
+    add_files("src/automation/gray_conversion.cc")
+    add_files("src/automation/window_geometry.cc")
+    add_files("src/behaviors/price_store.cc")
+    add_files("src/behaviors/sell_planner.cc")
+    add_files("src/runtime/*.cc")
+    add_tests("default")